@@ -0,0 +1,188 @@
+/**
+ * ITU G.711 CODEC
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * NOT FOR COMMERCIAL USE WITHOUT PERMISSION.
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <algorithm>
+
+#include "itu-g711-codec/codec.h"
+#include "itu-g711-codec/G711FileReader.h"
+
+using namespace std;
+
+namespace kc1fsz {
+
+// WAV format tags
+static const uint16_t WAVE_FORMAT_MULAW = 0x0007;
+static const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xfffe;
+
+static uint16_t readLe16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t readLe32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+G711FileReader::G711FileReader() {
+}
+
+G711FileReader::~G711FileReader() {
+    close();
+}
+
+bool G711FileReader::open(const char* fileName, unsigned rawSampleRate) {
+
+    close();
+
+    int fd = ::open(fileName, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (m == MAP_FAILED)
+        return false;
+    // Access will be by time offset, so read-ahead of the whole 
+    // file is not helpful.
+    madvise(m, st.st_size, MADV_RANDOM);
+
+    _map = (const uint8_t*)m;
+    _mapLen = st.st_size;
+
+    if (_mapLen >= 12 && 
+        memcmp(_map, "RIFF", 4) == 0 && 
+        memcmp(_map + 8, "WAVE", 4) == 0) {
+        if (!_parseWav()) {
+            close();
+            return false;
+        }
+    }
+    else {
+        _data = _map;
+        _sampleCount = _mapLen;
+        _sampleRate = rawSampleRate;
+    }
+    return true;
+}
+
+void G711FileReader::close() {
+    if (_map)
+        munmap((void*)_map, _mapLen);
+    _map = nullptr;
+    _mapLen = 0;
+    _data = nullptr;
+    _sampleCount = 0;
+}
+
+bool G711FileReader::isOpen() const {
+    return _map != nullptr;
+}
+
+unsigned G711FileReader::getSampleRate() const {
+    return _sampleRate;
+}
+
+uint64_t G711FileReader::getSampleCount() const {
+    return _sampleCount;
+}
+
+uint64_t G711FileReader::msToSample(uint64_t ms) const {
+    return (ms * _sampleRate) / 1000;
+}
+
+span<const uint8_t> G711FileReader::encoded(uint64_t startMs,
+    uint64_t lengthMs) const {
+    uint64_t start = std::min(msToSample(startMs), _sampleCount);
+    uint64_t end = std::min(msToSample(startMs + lengthMs), _sampleCount);
+    if (end > start) {
+        // Let the kernel start reading the window. The address 
+        // has to be page-aligned.
+        const uintptr_t pageMask = ~((uintptr_t)sysconf(_SC_PAGESIZE) - 1);
+        uintptr_t a = (uintptr_t)(_data + start) & pageMask;
+        madvise((void*)a, (uintptr_t)(_data + end) - a, MADV_WILLNEED);
+    }
+    return span<const uint8_t>(_data + start, end - start);
+}
+
+unsigned G711FileReader::decode(uint64_t startMs, uint64_t lengthMs,
+    int16_t* out, unsigned outCapacity) const {
+    span<const uint8_t> window = encoded(startMs, lengthMs);
+    unsigned len = std::min((uint64_t)window.size(), (uint64_t)outCapacity);
+    decode_ulaw_block(window.data(), out, len);
+    return len;
+}
+
+bool G711FileReader::_parseWav() {
+
+    bool haveFormat = false;
+    // Walk the chunks that follow the RIFF header
+    size_t p = 12;
+    while (p + 8 <= _mapLen) {
+        const uint8_t* chunk = _map + p;
+        uint32_t chunkLen = readLe32(chunk + 4);
+        const uint8_t* body = chunk + 8;
+        size_t bodyAvail = _mapLen - (p + 8);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (chunkLen < 16 || bodyAvail < 16)
+                return false;
+            uint16_t formatTag = readLe16(body);
+            // The extensible format carries the real tag at the 
+            // start of the sub-format GUID
+            if (formatTag == WAVE_FORMAT_EXTENSIBLE) {
+                if (chunkLen < 26 || bodyAvail < 26)
+                    return false;
+                formatTag = readLe16(body + 24);
+            }
+            uint16_t channels = readLe16(body + 2);
+            uint16_t bitsPerSample = readLe16(body + 14);
+            if (formatTag != WAVE_FORMAT_MULAW || channels != 1 ||
+                bitsPerSample != 8)
+                return false;
+            if (readLe32(body + 4) == 0)
+                return false;
+            _sampleRate = readLe32(body + 4);
+            haveFormat = true;
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat)
+                return false;
+            _data = body;
+            // Tolerate truncated files (recorders that crashed 
+            // before fixing up the header)
+            _sampleCount = std::min((size_t)chunkLen, bodyAvail);
+            return true;
+        }
+        // Chunks are padded to an even length
+        p += 8 + (size_t)chunkLen + (chunkLen & 1);
+    }
+    return false;
+}
+
+}
@@ -28,15 +28,29 @@ using namespace std;
 
 namespace kc1fsz {
 
-Plc::Plc() {
+/**
+ * Exact correlation of every other sample.
+ */
+static int64_t dot2(const int16_t* a, const int16_t* b, unsigned len) {
+    int64_t sum = 0;
+    for (unsigned i = 0; i < len; i += 2)
+        sum += (int32_t)a[i] * (int32_t)b[i];
+    return sum;
+}
+
+template<unsigned SampleRate, unsigned FrameMs>
+BasicPlc<SampleRate, FrameMs>::BasicPlc() {
     reset();
 }
 
-void Plc::setSampleRate(unsigned hz) {
-    assert(hz == 8000 || hz == 16000 || hz == 48000);
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::setSampleRate(unsigned hz) {
+    assert(hz == SampleRate);
+    reset();
 }
 
-void Plc::goodFrame(const int16_t* inFrame, int16_t* outFrame, 
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::goodFrame(const int16_t* inFrame, int16_t* outFrame, 
     unsigned frameLen) {
 
     // Shift history left
@@ -50,23 +64,21 @@ void Plc::goodFrame(const int16_t* inFrame, int16_t* outFrame,
     if (_erasureCount > 0) {
         // For the lag period, keep flowing the synthetic data 
         // (need to catch up to the start of the new frame).
-        unsigned i = 0;
-        for (; i < _outputLag; i++) {
-            int16_t s = _getSyntheticSample();
-            outFrame[i] = s;
-            // We also plug the synthetic value into the history 
-            // buffer in the place that it would have come from
-            // if everything was going well. This may be used 
-            // if we quickly switch back into an erasure
-            _histBuf[_histBufLen - _frameLen - _outputLag + i] = s;
-        }
+        int16_t* histOut = _histBuf + _histBufLen - _frameLen - _outputLag;
+        _synthesize(outFrame, _outputLag);
+        // We also plug the synthetic values into the history 
+        // buffer in the place that they would have come from
+        // if everything was going well. This may be used 
+        // if we quickly switch back into an erasure
+        memcpy(histOut, outFrame, sizeof(int16_t) * _outputLag);
+        unsigned i = _outputLag;
 
         // After the lag period we fade from the synthetic data
         // over to the real data. The length of this period is 1/4
-        // wavelength for the first 10m erasure and 4ms (32 samples)
-        // for each additional erasure, not to exceed the length 
+        // wavelength for the first 10ms of erasure and 4ms (32 samples 
+        // at 8kHz) for each additional 10ms, not to exceed the length 
         // of the frame.
-        unsigned fadeLen = _quarterPitchWavelen + 32 * (_erasureCount - 1);
+        unsigned fadeLen = _quarterPitchWavelen + _fadeStep * (_erasureCount - 1);
         // Make sure the fade doesn't extend past this frame. And
         // remember that we've already used _outputLag from the frame.
         fadeLen = std::min(fadeLen, _frameLen - _outputLag);
@@ -75,8 +87,7 @@ void Plc::goodFrame(const int16_t* inFrame, int16_t* outFrame,
         // but a triangle could be used if there are efficiency 
         // concerns.
         const unsigned blendCoefLen = _frameLen - _outputLag; 
-        assert(blendCoefLen == 80 - 30);
-        float blendCoef[50];
+        float blendCoef[_frameLen];
         for (unsigned j = 0; j < fadeLen; j++) {
             float frac = (float)j / (float)fadeLen;
             // Set the phase so that we go through a half cycle 
@@ -86,24 +97,20 @@ void Plc::goodFrame(const int16_t* inFrame, int16_t* outFrame,
         }
         
         // Build the blend during the fade period
+        int16_t synth[_frameLen];
+        _synthesize(synth, fadeLen);
         for (unsigned f = 0; f < fadeLen; f++, i++) {
-            float s0FadedOut = 
-                (float)_getSyntheticSample() * (1.0 - blendCoef[f]);
-            float s1FadedIn = (float)_histBuf[_histBufLen - _frameLen - 
-                _outputLag + i] * blendCoef[f];
+            float s0FadedOut = (float)synth[f] * (1.0 - blendCoef[f]);
+            float s1FadedIn = (float)histOut[i] * blendCoef[f];
             int16_t s = s0FadedOut + s1FadedIn;
             outFrame[i] = s;
-            // We also plug the synthetic value into the history 
-            // buffer in the place that it would have come from
-            // if everything was going well. This may be used 
-            // if we quickly switch back into an erasure
-            _histBuf[_histBufLen - _frameLen - _outputLag + i] = s;
+            // Same as above
+            histOut[i] = s;
         }
 
         // And anything left is just handled the normal way.
         for (; i < _frameLen; i++)
-            outFrame[i] = _histBuf[_histBufLen - _frameLen - 
-                _outputLag + i];
+            outFrame[i] = histOut[i];
         _erasureCount = 0;
     }
     else {
@@ -112,13 +119,46 @@ void Plc::goodFrame(const int16_t* inFrame, int16_t* outFrame,
             outFrame[i] = _histBuf[_histBufLen - _frameLen - 
                 _outputLag + i];
     }
+
+    // The history is final at this point
+    if (_pitchTracking)
+        _trackPitch();
 }
 
-void Plc::badFrame(int16_t* outFrame, 
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::badFrame(int16_t* outFrame, 
     unsigned frameLen) {
 
     assert(frameLen == _frameLen);
-    
+
+    // The first 10ms of this frame. At the start of an erasure this 
+    // captures the pitch buffer from the history, so it has to 
+    // happen before the shift.
+    _advanceErasure();
+
+    // Shift history left
+    memmove(_histBuf, _histBuf + _frameLen,  
+        sizeof(int16_t) * (_histBufLen - _frameLen));
+
+    // Populate output with interpolated data. The Appendix I state
+    // changes every 10ms so longer frames are synthesized in 10ms
+    // pieces.
+    _synthesize(outFrame, _unitLen);
+    for (unsigned u = 1; u < _unitsPerFrame; u++) {
+        _advanceErasure();
+        _synthesize(outFrame + u * _unitLen, _unitLen);
+    }
+    // We also plug the synthetic values into the history 
+    // buffer in the place that they would have come from
+    // if everything was going well. This may be used 
+    // if we quickly switch back into an erasure.
+    memcpy(_histBuf + _histBufLen - _frameLen - _outputLag, outFrame,
+        sizeof(int16_t) * _frameLen);
+}
+
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::_advanceErasure() {
+
     _erasureCount++;
 
     // In this a transition into an erasure? If so, capture the 
@@ -137,10 +177,11 @@ void Plc::badFrame(int16_t* outFrame,
         // pointer (phase) is unchanged to avoid any
         // discontinuity.
         _pitchWaveCount = 2;
-        // Once we hit the second erasure we turn on the attenuation.
+        // Once we hit the second 10ms we turn on the attenuation.
         // The specification requires 20% per 10ms, so that means
-        // 0.2 for every frame or 0.2 / 80 = 0.0025 for every sample.
-        _attenuationRampDelta = -0.2 / (float)_frameLen;
+        // 0.2 for every 10ms or 0.2 / 80 = 0.0025 for every sample
+        // at 8kHz.
+        _attenuationRampDelta = -0.2 / (float)_unitLen;
     }
     else if (_erasureCount == 3) {
         // We change the number of wavelengths but the 
@@ -150,42 +191,168 @@ void Plc::badFrame(int16_t* outFrame,
     }
 
     // NOTE: There is no further update the wavelength count
-    // after the third erasure.
+    // after 30ms.
+}
 
-    // Shift history left
-    memmove(_histBuf, _histBuf + _frameLen,  
-        sizeof(int16_t) * (_histBufLen - _frameLen));
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::badFrames(int16_t* outFrames, 
+    unsigned frameCount, unsigned frameLen) {
 
-    // Populate output with interpolated data
-    for (unsigned i = 0; i < _frameLen; i++) {
-        int16_t s = _getSyntheticSample();
-        outFrame[i] = s;
-        // We also plug the synthetic value into the history 
-        // buffer in the place that it would have come from
-        // if everything was going well. This may be used 
-        // if we quickly switch back into an erasure.
-        _histBuf[_histBufLen - _frameLen - _outputLag + i] = s;
+    assert(frameLen == _frameLen);
+
+    // Run normally until the output has been attenuated all the 
+    // way down. After the third erasure nothing changes except the 
+    // position in the pitch buffer.
+    unsigned j = 0;
+    for (; j < frameCount; j++) {
+        if (_erasureCount >= 3 && 
+            _attenuationRamp == 0 && _attenuationRampDelta <= 0 &&
+            !_backBlendPending && _backBlendPtr >= _quarterPitchWavelen)
+            break;
+        badFrame(outFrames + j * _frameLen, _frameLen);
+    }
+    if (j == frameCount)
+        return;
+
+    // The rest of the outage is silent
+    const unsigned silentCount = frameCount - j;
+    memset(outFrames + j * _frameLen, 0, 
+        sizeof(int16_t) * _frameLen * silentCount);
+    _erasureCount += silentCount * _unitsPerFrame;
+
+    // Advance the pointer as if each sample had been generated. It 
+    // is circulating through the last _pitchWaveCount wavelengths.
+    const unsigned cycleLen = _pitchWavelen * _pitchWaveCount;
+    const unsigned cycleStart = _pitchBufLen - cycleLen;
+    assert(_pitchBufPtr >= cycleStart);
+    _pitchBufPtr = cycleStart + (unsigned)(((uint64_t)(_pitchBufPtr - cycleStart) + 
+        (uint64_t)silentCount * _frameLen) % cycleLen);
+
+    // The history ends up with silence everywhere except the last 
+    // _outputLag samples, which are never overwritten during an 
+    // erasure. Only enough frames to flush the history are needed.
+    const unsigned histCount = std::min(silentCount, 
+        _histBufLen / _frameLen + 1);
+    for (unsigned k = 0; k < histCount; k++) {
+        memmove(_histBuf, _histBuf + _frameLen,  
+            sizeof(int16_t) * (_histBufLen - _frameLen));
+        memset(_histBuf + _histBufLen - _frameLen - _outputLag, 0,
+            sizeof(int16_t) * _frameLen);
     }
 }
 
-unsigned Plc::getPitchWavelength() const {
+template<unsigned SampleRate, unsigned FrameMs>
+unsigned BasicPlc<SampleRate, FrameMs>::getPitchWavelength() const {
     return _pitchWavelen;
 }
 
-void Plc::reset() {
+template<unsigned SampleRate, unsigned FrameMs>
+unsigned BasicPlc<SampleRate, FrameMs>::getOutputLag() const {
+    return _outputLag;
+}
+
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::setOutputLag(unsigned samples) {
+    assert(samples <= MAX_OUTPUT_LAG);
+    _outputLag = std::min(samples, MAX_OUTPUT_LAG);
+    reset();
+}
+
+template<unsigned SampleRate, unsigned FrameMs>
+bool BasicPlc<SampleRate, FrameMs>::getPitchTracking() const {
+    return _pitchTracking;
+}
+
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::setPitchTracking(bool on) {
+    _pitchTracking = on;
+    reset();
+}
+
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::reset() {
     memset(_histBuf, 0, sizeof(_histBuf));
     memset(_pitchBuf, 0, sizeof(_pitchBuf));
     memset(_blendCoef, 0, sizeof(_blendCoef));
+    // Consistent with the silent history
+    memset(_trackCorr, 0, sizeof(_trackCorr));
     _pitchWavelen = 0;
     _erasureCount = 0;
     _attenuationRamp = 1.0;
     _attenuationRampDelta = 0.0;
     _pitchBufPtr = 0;
+    _backBlendPending = false;
+    _backBlendPtr = 0;
     _quarterPitchWavelen = 0;
     _pitchWaveCount = 1;
 }
 
-void Plc::_computePitchPeriod() {
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::snapshot(Snapshot& snap) const {
+    snap.version = SNAPSHOT_VERSION;
+    snap.rateKhz = SampleRate / 1000;
+    snap.frameMs = FrameMs;
+    snap.pitchWaveCount = _pitchWaveCount;
+    snap.erasureCount = _erasureCount;
+    snap.pitchBufPtr = _pitchBufPtr;
+    snap.pitchWavelen = _pitchWavelen;
+    snap.outputLag = _outputLag;
+    snap.backBlendPending = _backBlendPending;
+    snap.backBlendPtr = _backBlendPtr;
+    snap.attenuationRamp = _attenuationRamp;
+    snap.attenuationRampDelta = _attenuationRampDelta;
+    memcpy(snap.histBuf, _histBuf, sizeof(_histBuf));
+    // The pitch buffer is only live during an erasure (and the 
+    // recovery frame that follows it). It gets re-captured from 
+    // the history at the start of the next erasure. It is zeroed
+    // otherwise so that the snapshot is fully defined.
+    if (_erasureCount > 0)
+        memcpy(snap.pitchBuf, _pitchBuf, sizeof(_pitchBuf));
+    else
+        memset(snap.pitchBuf, 0, sizeof(snap.pitchBuf));
+}
+
+template<unsigned SampleRate, unsigned FrameMs>
+bool BasicPlc<SampleRate, FrameMs>::restore(const Snapshot& snap) {
+
+    if (snap.version != SNAPSHOT_VERSION ||
+        snap.rateKhz != SampleRate / 1000 ||
+        snap.frameMs != FrameMs)
+        return false;
+    if (snap.pitchWaveCount < 1 || snap.pitchWaveCount > 3 ||
+        snap.outputLag > MAX_OUTPUT_LAG)
+        return false;
+    if (snap.erasureCount > 0) {
+        if (snap.pitchWavelen < pitchPeriodMin || 
+            snap.pitchWavelen > pitchPeriodMax ||
+            snap.pitchBufPtr >= _pitchBufLen ||
+            snap.backBlendPtr > snap.pitchWavelen / 4)
+            return false;
+    }
+
+    _pitchWaveCount = snap.pitchWaveCount;
+    _erasureCount = snap.erasureCount;
+    _pitchBufPtr = snap.pitchBufPtr;
+    _pitchWavelen = snap.pitchWavelen;
+    _quarterPitchWavelen = _pitchWavelen / 4;
+    _outputLag = snap.outputLag;
+    _backBlendPending = snap.backBlendPending;
+    _backBlendPtr = snap.backBlendPtr;
+    _attenuationRamp = snap.attenuationRamp;
+    _attenuationRampDelta = snap.attenuationRampDelta;
+    memcpy(_histBuf, snap.histBuf, sizeof(_histBuf));
+    if (_pitchTracking)
+        _trackPitch();
+    if (_erasureCount > 0) {
+        memcpy(_pitchBuf, snap.pitchBuf, sizeof(_pitchBuf));
+        // The blend curve is completely determined by the wavelength
+        _buildBlendCoef();
+    }
+    return true;
+}
+
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::_computePitchPeriod() {
 
     // Setup the anchor points for the correlation. p1 is the beginning
     // of the newest 20ms block in the pitch buffer.
@@ -201,26 +368,56 @@ void Plc::_computePitchPeriod() {
 
     // During the coarse search we test every other tap. The scan starts
     // from the longest pitch period and ends at the highest pitch period.
-    for (unsigned tapOffset = tapOffsetHigh; tapOffset >= tapOffsetLow; 
-        tapOffset -= step) {
-        float energy = 0;
-        float corr = 0;
-        unsigned p0 = _pitchBufLen - corrLen - tapOffset; 
-        // This is the cross-correlation between the final 
-        // frame of audio and the shifted version.
-        for (unsigned i = 0; i < corrLen; i += step) {
-            int16_t s0 = _pitchBuf[p0 + i];
-            int16_t s1 = _pitchBuf[p1 + i];
-            energy += (float)s0 * (float)s0;
-            corr += (float)s0 * (float)s1;
+    if (!_pitchTracking) {
+        for (unsigned tapOffset = tapOffsetHigh; tapOffset >= tapOffsetLow; 
+            tapOffset -= step) {
+            float energy = 0;
+            float corr = 0;
+            unsigned p0 = _pitchBufLen - corrLen - tapOffset; 
+            // This is the cross-correlation between the final 
+            // frame of audio and the shifted version.
+            for (unsigned i = 0; i < corrLen; i += step) {
+                int16_t s0 = _pitchBuf[p0 + i];
+                int16_t s1 = _pitchBuf[p1 + i];
+                energy += (float)s0 * (float)s0;
+                corr += (float)s0 * (float)s1;
+            }
+            float scale = std::max(energy, minPower);
+            corr = abs(corr / sqrt(scale));
+
+            // Any better?
+            if (corr > bestCorr) {
+                bestCorr = corr;
+                bestOffset = tapOffset;
+            }
         }
-        float scale = std::max(energy, minPower);
-        corr = abs(corr / sqrt(scale));
-
-        // Any better?
-        if (corr > bestCorr) {
-            bestCorr = corr;
-            bestOffset = tapOffset;
+    }
+    // With pitch tracking the correlations against the newest audio 
+    // were computed by goodFrame(). What's left is the older part of 
+    // the window (if any) and the energies, which are updated as
+    // the shifted window slides.
+    else {
+        const unsigned restLen = corrLen - _trackLen;
+        const int16_t* w = _pitchBuf + p1 - tapOffsetHigh;
+        int64_t energy = dot2(w, w, corrLen);
+        for (unsigned t = 0; t < _coarseTapCount; t++) {
+            unsigned tapOffset = tapOffsetHigh - step * t;
+            unsigned p0 = p1 - tapOffset;
+            if (t > 0) {
+                energy -= (int32_t)_pitchBuf[p0 - step] * _pitchBuf[p0 - step];
+                energy += (int32_t)_pitchBuf[p0 + corrLen - step] * 
+                    _pitchBuf[p0 + corrLen - step];
+            }
+            float corr = _trackCorr[t] + 
+                (float)dot2(_pitchBuf + p0, _pitchBuf + p1, restLen);
+            float scale = std::max((float)energy, minPower);
+            corr = abs(corr / sqrt(scale));
+
+            // Any better?
+            if (corr > bestCorr) {
+                bestCorr = corr;
+                bestOffset = tapOffset;
+            }
         }
     }
     
@@ -270,6 +467,33 @@ void Plc::_computePitchPeriod() {
     // audio phase.
     _pitchBufPtr = _pitchBufLen - _outputLag;
 
+    // With a short lag the real audio at the end of the pitch buffer
+    // has already been played out (at least partially) so there is 
+    // no chance to blend it toward the wrap-around. Instead, the real 
+    // audio is played to the end and the start of the synthetic audio 
+    // is blended with a time-reversed copy of the tail of the real 
+    // audio.
+    _backBlendPending = _outputLag < _quarterPitchWavelen;
+    _backBlendPtr = _quarterPitchWavelen;
+    if (_pitchBufPtr == _pitchBufLen) {
+        _pitchBufPtr = _pitchBufLen - _pitchWavelen * _pitchWaveCount;
+        _backBlendPending = false;
+        _backBlendPtr = 0;
+    }
+
+    _buildBlendCoef();
+}
+
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::_trackPitch() {
+    // Same layout as the coarse search in _computePitchPeriod()
+    const int16_t* p1 = _histBuf + _histBufLen - _trackLen;
+    for (unsigned t = 0; t < _coarseTapCount; t++)
+        _trackCorr[t] = dot2(p1 - (pitchPeriodMax - 2 * t), p1, _trackLen);
+}
+
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::_buildBlendCoef() {
     // Fill the blend coefficient buffer based on the new wavelength. 
     // Here we are using a Hanning window function to minimize the 
     // spectral impact of the blend.
@@ -282,41 +506,98 @@ void Plc::_computePitchPeriod() {
     }
 }
 
-int16_t Plc::_getSyntheticSample() {
+template<unsigned SampleRate, unsigned FrameMs>
+void BasicPlc<SampleRate, FrameMs>::_synthesize(int16_t* out, unsigned len) {
 
+    assert(len <= _frameLen);
     assert(_pitchBufPtr < _pitchBufLen);
     assert(_pitchWavelen * _pitchWaveCount <= _pitchBufLen);
-    int16_t s0 = _pitchBuf[_pitchBufPtr]; 
-    int16_t s0FadedOut = s0;
-    int16_t s1FadedIn = 0;
-
-    // Inside of the 1/4 wavelength transition period we are preparing
-    // to wrap around to the start of the buffer so we want to 
-    // fade out the end of the buffer and fade in the start.
-    if (_pitchBufPtr >= _pitchBufLen - _quarterPitchWavelen) {
-        assert(_pitchWavelen * _pitchWaveCount <= _pitchBufPtr);
-        int16_t s1 = _pitchBuf[_pitchBufPtr - (_pitchWavelen * _pitchWaveCount)];
-        unsigned blendPtr = _pitchBufPtr - (_pitchBufLen - _quarterPitchWavelen);
-        assert(blendPtr < _quarterPitchWavelen);
-        s0FadedOut = (float)s0 * (1.0 - _blendCoef[blendPtr]);
-        s1FadedIn = (float)s1 * _blendCoef[blendPtr];
-    }
 
-    // Move across the pitch buffer, wrapping as needed.
-    if (++_pitchBufPtr == _pitchBufLen) {
-        assert(_pitchWavelen * _pitchWaveCount < _pitchBufLen);
-        _pitchBufPtr = _pitchBufLen - _pitchWavelen * _pitchWaveCount;
-    }
+    const unsigned cycleLen = _pitchWavelen * _pitchWaveCount;
+    const unsigned fadeStart = _pitchBufLen - _quarterPitchWavelen;
+
+    // Produce the un-attenuated samples as a series of runs. Each 
+    // run ends at the next point where the behavior changes.
+    unsigned i = 0;
+    while (i < len) {
+        const int16_t* src = _pitchBuf + _pitchBufPtr;
+        unsigned n;
+
+        // Low-latency start of an erasure: fade out the time-reversed
+        // end of the real audio and fade in the synthetic audio.
+        if (_backBlendPtr < _quarterPitchWavelen) {
+            n = std::min({ len - i, _quarterPitchWavelen - _backBlendPtr, 
+                _pitchBufLen - _pitchBufPtr });
+            const int16_t* rev = _pitchBuf + _pitchBufLen - 1 - _backBlendPtr;
+            const float* coef = _blendCoef + _backBlendPtr;
+            for (unsigned k = 0; k < n; k++) {
+                int16_t s0FadedOut = (float)rev[-(int)k] * (1.0 - coef[k]);
+                int16_t s1FadedIn = (float)src[k] * coef[k];
+                out[i + k] = s0FadedOut + s1FadedIn;
+            }
+            _backBlendPtr += n;
+        }
+        // Inside of the 1/4 wavelength transition period we are preparing
+        // to wrap around to the start of the buffer so we want to 
+        // fade out the end of the buffer and fade in the start.
+        else if (!_backBlendPending && _pitchBufPtr >= fadeStart) {
+            assert(cycleLen <= _pitchBufPtr);
+            n = std::min(len - i, _pitchBufLen - _pitchBufPtr);
+            const int16_t* start = src - cycleLen;
+            const float* coef = _blendCoef + (_pitchBufPtr - fadeStart);
+            for (unsigned k = 0; k < n; k++) {
+                int16_t s0FadedOut = (float)src[k] * (1.0 - coef[k]);
+                int16_t s1FadedIn = (float)start[k] * coef[k];
+                out[i + k] = s0FadedOut + s1FadedIn;
+            }
+        }
+        // Otherwise it's a straight copy up to the next transition
+        else {
+            unsigned end = _backBlendPending ? _pitchBufLen : fadeStart;
+            n = std::min(len - i, end - _pitchBufPtr);
+            memcpy(out + i, src, sizeof(int16_t) * n);
+        }
 
-    // Apply the attenuation
-    float result = (s0FadedOut + s1FadedIn) * _attenuationRamp;
-    _attenuationRamp += _attenuationRampDelta;
-    if (_attenuationRamp < 0)
-        _attenuationRamp = 0;
-    if (_attenuationRamp > 1.0)
-        _attenuationRamp = 1.0;
+        i += n;
+        // Move across the pitch buffer, wrapping as needed.
+        _pitchBufPtr += n;
+        if (_pitchBufPtr == _pitchBufLen) {
+            assert(cycleLen < _pitchBufLen);
+            _pitchBufPtr = _pitchBufLen - cycleLen;
+            if (_backBlendPending) {
+                _backBlendPending = false;
+                _backBlendPtr = 0;
+            }
+        }
+    }
 
-    return result;
+    // Apply the attenuation. Nothing to do at full level, and once 
+    // the ramp has reached the bottom it stays there.
+    if (_attenuationRamp == 1.0 && _attenuationRampDelta >= 0)
+        return;
+    if (_attenuationRamp == 0 && _attenuationRampDelta <= 0) {
+        memset(out, 0, sizeof(int16_t) * len);
+        return;
+    }
+    // The ramp is accumulated exactly as it would be sample by 
+    // sample, then applied in one pass.
+    float ramp[_frameLen];
+    for (unsigned k = 0; k < len; k++) {
+        ramp[k] = _attenuationRamp;
+        _attenuationRamp += _attenuationRampDelta;
+        if (_attenuationRamp < 0)
+            _attenuationRamp = 0;
+        if (_attenuationRamp > 1.0)
+            _attenuationRamp = 1.0;
+    }
+    for (unsigned k = 0; k < len; k++)
+        out[k] = (float)out[k] * ramp[k];
 }
 
+// The supported configurations
+template class BasicPlc<8000, 10>;
+template class BasicPlc<8000, 20>;
+template class BasicPlc<16000, 10>;
+template class BasicPlc<48000, 10>;
+
 }
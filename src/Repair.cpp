@@ -0,0 +1,143 @@
+/**
+ * ITU G.711 Appendix 1 PLC Algorithm
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "itu-g711-plc/Repair.h"
+
+using namespace std;
+
+namespace kc1fsz {
+
+static const unsigned frameLen = Plc::FRAME_LEN;
+
+// The number of good frames needed before the history is made
+// up entirely of real input. The first good frame after an erasure
+// has some blended audio written back into the history, which is 
+// why there is one extra.
+static const unsigned primingFrames = 1 + (Plc::HIST_LEN + frameLen - 1) / frameLen;
+
+static bool isLost(const uint8_t* lossMap, unsigned frame) {
+    return (lossMap[frame / 8] >> (frame % 8)) & 1;
+}
+
+struct Segment {
+    unsigned start;
+    unsigned end;
+    // The number of pitch periods that the Plc will be using at
+    // the start of the segment.
+    unsigned pitchWaveCount;
+};
+
+static void repairSegment(const Segment& seg, const int16_t* pcm,
+    const uint8_t* lossMap, int16_t* out, unsigned outputLag) {
+
+    Plc plc;
+    plc.setOutputLag(outputLag);
+
+    // Prime with the audio leading up to the segment
+    if (seg.start > 0) {
+        Plc::Snapshot snap;
+        plc.snapshot(snap);
+        memcpy(snap.histBuf, pcm + seg.start * frameLen - Plc::HIST_LEN,
+            sizeof(snap.histBuf));
+        snap.pitchWaveCount = seg.pitchWaveCount;
+        // This can only fail if the snapshot format is inconsistent
+        const bool ok = plc.restore(snap);
+        assert(ok);
+        (void)ok;
+    }
+
+    for (unsigned j = seg.start; j < seg.end; ) {
+        if (isLost(lossMap, j)) {
+            // Outages are handled in one call
+            unsigned n = 1;
+            while (j + n < seg.end && isLost(lossMap, j + n))
+                n++;
+            plc.badFrames(out + j * frameLen, n, frameLen);
+            j += n;
+        }
+        else {
+            plc.goodFrame(pcm + j * frameLen, out + j * frameLen, frameLen);
+            j++;
+        }
+    }
+}
+
+void repairRecording(const int16_t* pcm, const uint8_t* lossMap,
+    unsigned frameCount, int16_t* out, unsigned threadCount,
+    unsigned outputLag) {
+
+    if (threadCount == 0)
+        threadCount = std::max(1u, thread::hardware_concurrency());
+
+    // Aim for a few segments per thread to balance the load
+    const unsigned targetLen = std::max(primingFrames,
+        frameCount / (threadCount * 4) + 1);
+
+    // Find the split points
+    vector<Segment> segments;
+    segments.push_back({ 0, 0, 1 });
+    unsigned goodRun = 0, lostRun = 0;
+    unsigned pitchWaveCount = 1;
+    for (unsigned j = 0; j < frameCount; j++) {
+        if (goodRun >= primingFrames && 
+            j - segments.back().start >= targetLen) {
+            segments.back().end = j;
+            segments.push_back({ j, 0, pitchWaveCount });
+        }
+        if (isLost(lossMap, j)) {
+            goodRun = 0;
+            lostRun++;
+            // The Plc switches to 2 and then 3 pitch periods on the 
+            // 2nd and 3rd consecutive erasure, and that carries over 
+            // into the next erasure.
+            if (lostRun == 2 || lostRun == 3)
+                pitchWaveCount = lostRun;
+        }
+        else {
+            goodRun++;
+            lostRun = 0;
+        }
+    }
+    segments.back().end = frameCount;
+
+    threadCount = std::min(threadCount, (unsigned)segments.size());
+    if (threadCount <= 1) {
+        for (const Segment& seg : segments)
+            repairSegment(seg, pcm, lossMap, out, outputLag);
+        return;
+    }
+
+    atomic<unsigned> next { 0 };
+    vector<thread> workers;
+    for (unsigned t = 0; t < threadCount; t++)
+        workers.emplace_back([&]() {
+            unsigned s;
+            while ((s = next.fetch_add(1)) < segments.size())
+                repairSegment(segments[s], pcm, lossMap, out, outputLag);
+        });
+    for (thread& w : workers)
+        w.join();
+}
+
+}
@@ -0,0 +1,221 @@
+/**
+ * ITU G.711 Frame Transport
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ctime>
+
+#include <new>
+
+#include "itu-g711-transport/ShmRing.h"
+
+using namespace std;
+
+namespace kc1fsz {
+
+static size_t roundUp(size_t v, size_t m) {
+    return (v + m - 1) / m * m;
+}
+
+// The futex word is in a shared mapping so the non-private
+// operations are needed.
+static void futexWait(std::atomic<uint32_t>* addr, uint32_t expected,
+    const struct timespec* timeout) {
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, expected, timeout,
+        nullptr, 0);
+}
+
+static void futexWakeAll(std::atomic<uint32_t>* addr) {
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE, INT32_MAX, nullptr,
+        nullptr, 0);
+}
+
+ShmRing::ShmRing() {
+}
+
+ShmRing::~ShmRing() {
+    close();
+}
+
+size_t ShmRing::_slotLenFor(unsigned maxSamples) {
+    // Room for PCM, kept on cache line boundaries
+    return roundUp(sizeof(SlotHeader) + 2 * (size_t)maxSamples, CACHE_LINE);
+}
+
+size_t ShmRing::_regionLenFor(unsigned streamCount, unsigned slotCount,
+    unsigned maxSamples) {
+    return roundUp(sizeof(Header), CACHE_LINE) +
+        sizeof(Stream) * streamCount +
+        _slotLenFor(maxSamples) * slotCount * streamCount;
+}
+
+bool ShmRing::create(const char* name, unsigned streamCount,
+    unsigned slotCount, unsigned maxSamples) {
+
+    close();
+
+    if (streamCount == 0 || slotCount == 0 ||
+        (slotCount & (slotCount - 1)) != 0 ||
+        maxSamples == 0 || maxSamples > 0xffff)
+        return false;
+
+    int fd;
+    if (name == nullptr)
+        fd = memfd_create("g711-ring", MFD_CLOEXEC);
+    else
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, _regionLenFor(streamCount, slotCount, maxSamples)) != 0 ||
+        !_map(fd, true, streamCount, slotCount, maxSamples)) {
+        ::close(fd);
+        if (name != nullptr)
+            shm_unlink(name);
+        return false;
+    }
+    return true;
+}
+
+bool ShmRing::open(const char* name) {
+    close();
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return false;
+    if (!_map(fd, false, 0, 0, 0)) {
+        ::close(fd);
+        return false;
+    }
+    return true;
+}
+
+bool ShmRing::open(int fd) {
+    close();
+    int d = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (d < 0)
+        return false;
+    if (!_map(d, false, 0, 0, 0)) {
+        ::close(d);
+        return false;
+    }
+    return true;
+}
+
+bool ShmRing::_map(int fd, bool init, unsigned streamCount,
+    unsigned slotCount, unsigned maxSamples) {
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header))
+        return false;
+    void* m = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        fd, 0);
+    if (m == MAP_FAILED)
+        return false;
+    Header* h = (Header*)m;
+
+    if (init) {
+        // The region is zero-filled, which is a valid initial state
+        // for all of the counters.
+        new (&h->event) std::atomic<uint32_t>(0);
+        new (&h->waiters) std::atomic<uint32_t>(0);
+        for (unsigned i = 0; i < streamCount; i++)
+            new ((uint8_t*)m + roundUp(sizeof(Header), CACHE_LINE) +
+                sizeof(Stream) * i) Stream();
+        h->magic = MAGIC;
+        h->version = VERSION;
+        h->streamCount = streamCount;
+        h->slotCount = slotCount;
+        h->maxSamples = maxSamples;
+        h->slotLen = _slotLenFor(maxSamples);
+        h->regionLen = st.st_size;
+    }
+    else if (h->magic != MAGIC || h->version != VERSION ||
+        h->regionLen != (uint64_t)st.st_size ||
+        h->slotCount == 0 || (h->slotCount & (h->slotCount - 1)) != 0 ||
+        h->slotLen != _slotLenFor(h->maxSamples) ||
+        _regionLenFor(h->streamCount, h->slotCount, h->maxSamples) !=
+            (size_t)st.st_size) {
+        munmap(m, st.st_size);
+        return false;
+    }
+
+    _fd = fd;
+    _base = (uint8_t*)m;
+    _len = st.st_size;
+    _header = h;
+    _streamCount = h->streamCount;
+    _slotCount = h->slotCount;
+    _maxSamples = h->maxSamples;
+    _slotLen = h->slotLen;
+    _streams = (Stream*)(_base + roundUp(sizeof(Header), CACHE_LINE));
+    _slots = (uint8_t*)(_streams + _streamCount);
+    return true;
+}
+
+void ShmRing::close() {
+    if (_base != nullptr)
+        munmap(_base, _len);
+    if (_fd >= 0)
+        ::close(_fd);
+    _fd = -1;
+    _base = nullptr;
+    _len = 0;
+    _header = nullptr;
+    _streams = nullptr;
+    _slots = nullptr;
+    _streamCount = 0;
+    _slotCount = 0;
+    _maxSamples = 0;
+    _slotLen = 0;
+}
+
+void ShmRing::unlink(const char* name) {
+    shm_unlink(name);
+}
+
+void ShmRing::notify() {
+    _header->event.fetch_add(1, std::memory_order_seq_cst);
+    // Only go into the kernel if the consumer is (or is about to be)
+    // sleeping.
+    if (_header->waiters.load(std::memory_order_seq_cst) != 0)
+        futexWakeAll(&_header->event);
+}
+
+uint32_t ShmRing::getEvent() const {
+    return _header->event.load(std::memory_order_acquire);
+}
+
+uint32_t ShmRing::wait(uint32_t lastEvent, unsigned timeoutMs) {
+    _header->waiters.fetch_add(1, std::memory_order_seq_cst);
+    // The check happens after announcing the waiter so that a notify()
+    // can't slip in between.
+    uint32_t ev = _header->event.load(std::memory_order_seq_cst);
+    if (ev == lastEvent) {
+        struct timespec ts;
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+        futexWait(&_header->event, lastEvent, timeoutMs ? &ts : nullptr);
+        ev = _header->event.load(std::memory_order_acquire);
+    }
+    _header->waiters.fetch_sub(1, std::memory_order_seq_cst);
+    return ev;
+}
+
+}
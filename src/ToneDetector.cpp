@@ -0,0 +1,188 @@
+/**
+ * ITU G.711 CODEC
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * NOT FOR COMMERCIAL USE WITHOUT PERMISSION.
+ */
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <numbers>
+
+#include "itu-g711-codec/codec.h"
+#include "itu-g711-tone/ToneDetector.h"
+
+using namespace std;
+
+namespace kc1fsz {
+
+static const float sampleRate = 8000;
+
+// The DTMF rows and then the columns
+static const float dtmfFreqs[ToneDetector::DTMF_TONES] = 
+    { 697, 770, 852, 941, 1209, 1336, 1477, 1633 };
+static const char dtmfDigits[4][4] = {
+    { '1', '2', '3', 'A' },
+    { '4', '5', '6', 'B' },
+    { '7', '8', '9', 'C' },
+    { '*', '0', '#', 'D' } };
+
+// Anything quieter than this (mean square, about -33 dBm0) is ignored
+static const float minMeanSquare = 1.0e5;
+// The fraction of the block energy that must be accounted for by
+// the row + column tones of a DTMF digit
+static const float dtmfMinFraction = 0.6;
+// The fraction of the block energy that must be accounted for 
+// by a configured tone
+static const float toneMinFraction = 0.2;
+// Allowable twist (ratio of row/column tone power), 8 dB either way
+static const float maxTwist = 6.3;
+// The strongest row/column needs to be this much stronger than 
+// the others in its group (6 dB)
+static const float minGroupRatio = 4.0;
+
+static float goertzelCoef(float hz) {
+    return 2.0f * std::cos(2.0f * std::numbers::pi * hz / sampleRate);
+}
+
+ToneDetector::ToneDetector() {
+    for (unsigned i = 0; i < MAX_TONES; i++)
+        _coef[i] = 0;
+    for (unsigned i = 0; i < DTMF_TONES; i++)
+        _coef[i] = goertzelCoef(dtmfFreqs[i]);
+}
+
+int ToneDetector::addTone(float hz) {
+    if (_toneCount == MAX_TONES)
+        return -1;
+    _coef[_toneCount] = goertzelCoef(hz);
+    return _toneCount++ - DTMF_TONES;
+}
+
+void ToneDetector::resetState(State& state) const {
+    memset(&state, 0, sizeof(state));
+}
+
+bool ToneDetector::process(State& state, const uint8_t* ulaw, 
+    unsigned len) const {
+
+    bool completed = false;
+    int16_t pcm[BLOCK_LEN];
+
+    while (len > 0) {
+        // Work up to the end of the current block
+        unsigned n = std::min(len, BLOCK_LEN - state.count);
+        decode_ulaw_block(ulaw, pcm, n);
+        _update(state, pcm, n);
+        ulaw += n;
+        len -= n;
+        state.count += n;
+        if (state.count == BLOCK_LEN) {
+            _decide(state);
+            completed = true;
+        }
+    }
+    return completed;
+}
+
+void ToneDetector::processBatch(State* states, const uint8_t* const* frames,
+    unsigned streamCount, unsigned len, bool* completed) const {
+    for (unsigned s = 0; s < streamCount; s++) {
+        bool c = process(states[s], frames[s], len);
+        if (completed)
+            completed[s] = c;
+    }
+}
+
+void ToneDetector::_update(State& state, const int16_t* pcm, 
+    unsigned len) const {
+
+    // Local copies keep the filter bank in registers
+    float s1[MAX_TONES], s2[MAX_TONES];
+    memcpy(s1, state.s1, sizeof(s1));
+    memcpy(s2, state.s2, sizeof(s2));
+    float energy = state.energy;
+
+    for (unsigned i = 0; i < len; i++) {
+        const float x = pcm[i];
+        energy += x * x;
+        // All of the tones at once (this is the part that gets 
+        // vectorized)
+        for (unsigned k = 0; k < MAX_TONES; k++) {
+            float s0 = x + _coef[k] * s1[k] - s2[k];
+            s2[k] = s1[k];
+            s1[k] = s0;
+        }
+    }
+
+    memcpy(state.s1, s1, sizeof(s1));
+    memcpy(state.s2, s2, sizeof(s2));
+    state.energy = energy;
+}
+
+void ToneDetector::_decide(State& state) const {
+
+    // The power at each frequency, as a fraction of the power of 
+    // the whole block. A pure tone gives a Goertzel power of about
+    // (A * N / 2)^2 and a block energy of A^2 * N / 2.
+    float frac[MAX_TONES];
+    const float scale = 1.0f / 
+        (std::max(state.energy, 1.0f) * (float)BLOCK_LEN * 0.5f);
+    for (unsigned k = 0; k < MAX_TONES; k++) {
+        float p = state.s1[k] * state.s1[k] + state.s2[k] * state.s2[k] - 
+            _coef[k] * state.s1[k] * state.s2[k];
+        frac[k] = p * scale;
+    }
+
+    state.digit = 0;
+    state.tones = 0;
+
+    if (state.energy / (float)BLOCK_LEN >= minMeanSquare) {
+
+        // DTMF
+        unsigned row = 0, col = 4;
+        for (unsigned k = 1; k < 4; k++) {
+            if (frac[k] > frac[row])
+                row = k;
+            if (frac[k + 4] > frac[col])
+                col = k + 4;
+        }
+        bool ok = frac[row] + frac[col] >= dtmfMinFraction &&
+            frac[row] < frac[col] * maxTwist &&
+            frac[col] < frac[row] * maxTwist;
+        for (unsigned k = 0; k < 4 && ok; k++) {
+            if (k != row && frac[k] * minGroupRatio > frac[row])
+                ok = false;
+            if (k + 4 != col && frac[k + 4] * minGroupRatio > frac[col])
+                ok = false;
+        }
+        if (ok)
+            state.digit = dtmfDigits[row][col - 4];
+
+        // Configured tones
+        for (unsigned k = DTMF_TONES; k < _toneCount; k++)
+            if (frac[k] >= toneMinFraction)
+                state.tones |= 1 << (k - DTMF_TONES);
+    }
+
+    // Start the next block
+    memset(state.s1, 0, sizeof(state.s1));
+    memset(state.s2, 0, sizeof(state.s2));
+    state.energy = 0;
+    state.count = 0;
+}
+
+}
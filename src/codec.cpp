@@ -69,6 +69,31 @@ int16_t decode_ulaw(uint8_t c) {
     return a << 2;
 }
 
+// Table of all 256 decoded values, built at compile time
+// using the same logic as decode_ulaw().
+static constexpr struct DecodeTable {
+    int16_t v[256];
+    constexpr DecodeTable() : v() {
+        for (unsigned i = 0; i < 256; i++) {
+            uint8_t c = i ^ 0xff;
+            bool s_bit = (c & S_BIT_MASK_8) != 0;
+            int16_t a = 0b100001 | ((c & 0b1111) << 1);
+            a = a << ((c & 0b01110000) >> 4);
+            a = (a - 33) & 0b1111111111111;
+            if (s_bit)
+                a = -a;
+            // Multiply rather than shift since a can be negative and
+            // this has to be a constant expression before C++20
+            v[i] = a * 4;
+        }
+    }
+} ulawDecodeTable;
+
+void decode_ulaw_block(const uint8_t* in, int16_t* out, unsigned len) {
+    for (unsigned i = 0; i < len; i++)
+        out[i] = ulawDecodeTable.v[in[i]];
+}
+
 uint8_t encode_ulaw(int16_t a) {
     // Convert from 16-bit PCM to 14-bit PCM
     a >>= 2;
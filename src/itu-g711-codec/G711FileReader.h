@@ -0,0 +1,121 @@
+/**
+ * ITU G.711 CODEC
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * NOT FOR COMMERCIAL USE WITHOUT PERMISSION.
+ */
+#ifndef _g711_file_reader_h
+#define _g711_file_reader_h
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+
+namespace kc1fsz {
+
+/**
+ * Random access into (potentially very large) G.711 uLaw recordings.
+ *
+ * The file is memory-mapped and since each byte is one sample
+ * seeking to a time offset is a simple calculation. Only the pages
+ * that back the requested window are ever read from disk.
+ *
+ * Headerless (raw) files and mono 8-bit uLaw WAV files are supported.
+ * This is POSIX-only.
+ */
+class G711FileReader {
+public:
+
+    G711FileReader();
+    ~G711FileReader();
+
+    G711FileReader(const G711FileReader&) = delete;
+    G711FileReader& operator=(const G711FileReader&) = delete;
+
+    /**
+     * Maps a recording into memory. WAV files are recognized by
+     * their RIFF header, anything else is treated as raw uLaw.
+     *
+     * @param fileName The path to the recording.
+     * @param rawSampleRate The sample rate that will be assumed
+     *   if the file is raw (WAV files carry their own).
+     * @returns true on success, false if the file can't be
+     *   opened/mapped or is a WAV in an unsupported format.
+     */
+    bool open(const char* fileName, unsigned rawSampleRate = 8000);
+
+    /**
+     * Unmaps the file. This invalidates any views that have
+     * been returned.
+     */
+    void close();
+
+    bool isOpen() const;
+
+    unsigned getSampleRate() const;
+
+    /**
+     * @returns The length of the recording in samples.
+     */
+    uint64_t getSampleCount() const;
+
+    /**
+     * @returns The sample index that corresponds to the time offset,
+     * not clipped to the length of the recording.
+     */
+    uint64_t msToSample(uint64_t ms) const;
+
+    /**
+     * Zero-copy view of the encoded samples in a time window. The
+     * window is clipped to the end of the recording.
+     *
+     * @param startMs Offset from the start of the recording
+     * @param lengthMs The length of the window
+     * @returns A view directly into the mapped file. Valid until
+     *   close() is called.
+     */
+    std::span<const uint8_t> encoded(uint64_t startMs,
+        uint64_t lengthMs) const;
+
+    /**
+     * Decodes a time window into 16-bit PCM using the block
+     * decoder. The window is clipped to the end of the recording
+     * and to the size of the output buffer.
+     *
+     * @returns The number of samples written to out.
+     */
+    unsigned decode(uint64_t startMs, uint64_t lengthMs,
+        int16_t* out, unsigned outCapacity) const;
+
+private:
+
+    /**
+     * Locates the uLaw data inside of a RIFF/WAVE container.
+     * @returns false if the format isn't supported.
+     */
+    bool _parseWav();
+
+    const uint8_t* _map = nullptr;
+    size_t _mapLen = 0;
+    // Points at the first sample
+    const uint8_t* _data = nullptr;
+    uint64_t _sampleCount = 0;
+    unsigned _sampleRate = 8000;
+};
+
+}
+
+#endif
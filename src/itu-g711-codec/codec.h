@@ -44,6 +44,18 @@ uint8_t encode_ulaw(int16_t a);
  */
 int16_t decode_ulaw(uint8_t c);
 
+/**
+ * G.771 uLaw Block Decoder Function
+ *
+ * Decodes a block of samples using a lookup table. The results
+ * are identical to calling decode_ulaw() on each sample.
+ *
+ * @param in The 8-bit character signals.
+ * @param out Receives the signed 16-bit PCM audio samples.
+ * @param len The number of samples to decode.
+ */
+void decode_ulaw_block(const uint8_t* in, int16_t* out, unsigned len);
+
 }
 
 #endif
@@ -0,0 +1,296 @@
+/**
+ * ITU G.711 Audio Pipeline
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+#include <concepts>
+
+#include "itu-g711-codec/codec.h"
+
+namespace kc1fsz {
+
+/**
+ * A fixed-capacity audio frame that is passed (by pointer) through
+ * a pipeline. It carries both representations so that the decode and
+ * encode stages can work in place.
+ *
+ * @tparam MaxLen The largest number of samples that the frame
+ *   will ever need to hold (i.e. after any up-sampling).
+ */
+template<unsigned MaxLen> struct Frame {
+    static constexpr unsigned MAX_LEN = MaxLen;
+    // The number of valid samples
+    unsigned len = 0;
+    // Set when the frame was not received. The sample contents
+    // are undefined until a PlcStage fills them in.
+    bool erased = false;
+    int16_t pcm[MaxLen];
+    uint8_t ulaw[MaxLen];
+};
+
+/**
+ * A preallocated pool of frames. acquire()/release() are constant
+ * time and never touch the heap. This is intended for use by a
+ * single thread.
+ */
+template<typename FrameT, unsigned Count> class FramePool {
+public:
+
+    FramePool() {
+        for (unsigned i = 0; i < Count; i++)
+            _free[i] = &_frames[i];
+        _freeCount = Count;
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    /**
+     * @returns A frame, or nullptr if the pool is exhausted.
+     */
+    FrameT* acquire() {
+        if (_freeCount == 0)
+            return nullptr;
+        FrameT* f = _free[--_freeCount];
+        f->len = 0;
+        f->erased = false;
+        return f;
+    }
+
+    void release(FrameT* f) {
+        assert(f >= _frames && f < _frames + Count);
+        assert(_freeCount < Count);
+        _free[_freeCount++] = f;
+    }
+
+    /**
+     * @returns The number of frames available, mostly for leak checks.
+     */
+    unsigned available() const { return _freeCount; }
+
+private:
+
+    FrameT _frames[Count];
+    FrameT* _free[Count];
+    unsigned _freeCount;
+};
+
+/**
+ * Anything that can accept a frame. Ownership of the frame passes
+ * along with the push.
+ */
+template<typename S, typename FrameT>
+concept FrameSink = requires(S s, FrameT* f) { s.push(f); };
+
+/**
+ * The end of a pipeline. Hands each frame to a callable and then
+ * returns it to the pool.
+ */
+template<typename FrameT, unsigned Count, typename F> class SinkStage {
+public:
+
+    SinkStage(FramePool<FrameT, Count>& pool, F f)
+    :   _pool(pool), _f(f) { }
+
+    void push(FrameT* frame) {
+        _f(*frame);
+        _pool.release(frame);
+    }
+
+private:
+
+    FramePool<FrameT, Count>& _pool;
+    F _f;
+};
+
+/**
+ * uLaw -> PCM, in place. Erased frames are passed through untouched.
+ */
+template<typename FrameT, FrameSink<FrameT> Next> class DecodeStage {
+public:
+
+    DecodeStage(Next& next) : _next(next) { }
+
+    void push(FrameT* frame) {
+        if (!frame->erased)
+            decode_ulaw_block(frame->ulaw, frame->pcm, frame->len);
+        _next.push(frame);
+    }
+
+private:
+
+    Next& _next;
+};
+
+/**
+ * PCM -> uLaw, in place.
+ */
+template<typename FrameT, FrameSink<FrameT> Next> class EncodeStage {
+public:
+
+    EncodeStage(Next& next) : _next(next) { }
+
+    void push(FrameT* frame) {
+        for (unsigned i = 0; i < frame->len; i++)
+            frame->ulaw[i] = encode_ulaw(frame->pcm[i]);
+        _next.push(frame);
+    }
+
+private:
+
+    Next& _next;
+};
+
+/**
+ * Applies packet loss concealment. Good frames are run through the
+ * PLC in place and erased frames are synthesized, after which they
+ * are no longer marked as erased.
+ *
+ * @tparam PlcT Any of the BasicPlc configurations.
+ */
+template<typename FrameT, typename PlcT, FrameSink<FrameT> Next>
+class PlcStage {
+public:
+
+    PlcStage(PlcT& plc, Next& next) : _plc(plc), _next(next) { }
+
+    void push(FrameT* frame) {
+        static_assert(PlcT::FRAME_LEN <= FrameT::MAX_LEN);
+        if (frame->erased) {
+            frame->len = PlcT::FRAME_LEN;
+            _plc.badFrame(frame->pcm, frame->len);
+            frame->erased = false;
+        }
+        else {
+            assert(frame->len == PlcT::FRAME_LEN);
+            _plc.goodFrame(frame->pcm, frame->pcm, frame->len);
+        }
+        _next.push(frame);
+    }
+
+private:
+
+    PlcT& _plc;
+    Next& _next;
+};
+
+/**
+ * Integer-ratio sample rate conversion, in place. Up-sampling uses
+ * linear interpolation (which delays the output by one input sample)
+ * and down-sampling uses a simple block average. This is adequate
+ * for voice-band audio moving between 8/16/48 kHz.
+ */
+template<typename FrameT, unsigned FromRate, unsigned ToRate,
+    FrameSink<FrameT> Next>
+class ResampleStage {
+public:
+
+    static_assert(ToRate % FromRate == 0 || FromRate % ToRate == 0,
+        "Only integer ratios are supported");
+
+    ResampleStage(Next& next) : _next(next) { }
+
+    void push(FrameT* frame) {
+        if constexpr (ToRate > FromRate) {
+            const unsigned n = ToRate / FromRate;
+            assert(frame->len * n <= FrameT::MAX_LEN);
+            // Working backwards so that nothing is overwritten
+            // before it has been used.
+            for (unsigned i = frame->len; i-- > 0; ) {
+                int32_t s1 = frame->pcm[i];
+                int32_t s0 = (i == 0) ? _last : frame->pcm[i - 1];
+                for (unsigned k = 0; k < n; k++)
+                    frame->pcm[i * n + k] =
+                        s0 + ((s1 - s0) * (int32_t)(k + 1)) / (int32_t)n;
+            }
+            if (frame->len > 0)
+                _last = frame->pcm[frame->len * n - 1];
+            frame->len *= n;
+        }
+        else if constexpr (FromRate > ToRate) {
+            const unsigned n = FromRate / ToRate;
+            assert(frame->len % n == 0);
+            for (unsigned i = 0; i < frame->len / n; i++) {
+                int32_t sum = 0;
+                for (unsigned k = 0; k < n; k++)
+                    sum += frame->pcm[i * n + k];
+                frame->pcm[i] = sum / (int32_t)n;
+            }
+            frame->len /= n;
+        }
+        _next.push(frame);
+    }
+
+private:
+
+    Next& _next;
+    int16_t _last = 0;
+};
+
+/**
+ * Sums any number of streams into one. Call push() for each of the
+ * contributing frames and then flush() once per tick. The first frame
+ * of the tick is used as the accumulator and the others are returned
+ * to the pool as soon as they have been added in.
+ */
+template<typename FrameT, unsigned Count, FrameSink<FrameT> Next>
+class MixStage {
+public:
+
+    MixStage(FramePool<FrameT, Count>& pool, Next& next)
+    :   _pool(pool), _next(next) { }
+
+    void push(FrameT* frame) {
+        if (_acc == nullptr) {
+            _acc = frame;
+            return;
+        }
+        assert(frame->len == _acc->len);
+        for (unsigned i = 0; i < _acc->len; i++) {
+            int32_t s = (int32_t)_acc->pcm[i] + (int32_t)frame->pcm[i];
+            // Saturate
+            if (s > 32767)
+                s = 32767;
+            else if (s < -32768)
+                s = -32768;
+            _acc->pcm[i] = s;
+        }
+        _pool.release(frame);
+    }
+
+    /**
+     * Sends the mix downstream. Nothing happens if there were no
+     * contributors during this tick.
+     */
+    void flush() {
+        if (_acc) {
+            FrameT* f = _acc;
+            _acc = nullptr;
+            _next.push(f);
+        }
+    }
+
+private:
+
+    FramePool<FrameT, Count>& _pool;
+    Next& _next;
+    FrameT* _acc = nullptr;
+};
+
+}
@@ -26,58 +26,179 @@ namespace kc1fsz {
  * method. 
  * 
  * At the present time this implementation assumes 16 bit signed
- * PCM, and 10ms frame size.  Maximum sample rate is 48K.
+ * PCM. The sample rate and frame duration are fixed at compile time
+ * so that every buffer is sized exactly for the stream being handled
+ * (an 8 kHz instance is about 1.9 KB). The Appendix I constants are 
+ * stated for 8 kHz and are scaled up for higher rates.
+ *
+ * The implementation lives in Plc.cpp and is explicitly instantiated 
+ * for 8/16/48 kHz with 10ms frames and 8 kHz with 20ms frames.
+ * 
+ * @tparam SampleRate Audio sample rate in Hertz, a multiple of 8000.
+ * @tparam FrameMs Frame duration in milliseconds, a multiple of 10.
+ *   The erasure handling (wavelength count, attenuation, fade 
+ *   length) follows elapsed time so longer frames behave the same
+ *   as a series of 10ms frames.
  */
-class Plc {
+template<unsigned SampleRate, unsigned FrameMs> class BasicPlc {
 public:
 
-    Plc();
+    BasicPlc();
 
     /**
-     * Changes the sample rate and causes a reset.
-     * @param Audio sample rate in Hertz
+     * The sample rate is fixed by the template parameter. This is 
+     * retained for compatibility and just causes a reset.
+     * @param Audio sample rate in Hertz, must match SampleRate.
      */
     void setSampleRate(unsigned hz);
 
     /**
-     * Call this each time a good 10m frame of audio is received.
+     * Call this each time a good frame of audio is received.
      * Each call will consume frameLen samples and will produce
      * another frameLen samples.
      * 
      * @param inFrame The input PCM data
-     * @param outFrame The output PCM data
-     * @param frameLen Depends on the sample rate, but must be 10ms of data
+     * @param outFrame The output PCM data. This may be the same 
+     *   buffer as inFrame.
+     * @param frameLen Must be FRAME_LEN (FrameMs of data)
      */
     void goodFrame(const int16_t* inFrame, int16_t* outFrame, 
         unsigned frameLen);
 
     /**
-     * Call this each time a 10ms frame is missed. Output will still
+     * Call this each time a frame is missed. Output will still
      * be provided using the relevant PLC algorithm.
      * 
-     * @param frameLen Depends on the sample rate, but must be 10ms of data
+     * @param frameLen Must be FRAME_LEN (FrameMs of data)
      */
     void badFrame(int16_t* outFrame, unsigned frameLen);
 
+    /**
+     * Equivalent to calling badFrame() frameCount times, with the 
+     * output frames written one after the other. This is meant for
+     * long outages: once the synthetic audio has been attenuated 
+     * to silence the remaining frames cost almost nothing.
+     *
+     * @param outFrames Space for frameCount * frameLen samples.
+     * @param frameLen Must be FRAME_LEN (FrameMs of data)
+     */
+    void badFrames(int16_t* outFrames, unsigned frameCount, 
+        unsigned frameLen);
+
     /**
      * Diagnostic, returns current pitch wavelength as estimated
      * at the start of the last erasure.
      */
     unsigned getPitchWavelength() const;
 
+    /**
+     * @returns The delay (in samples) between the input and the 
+     * output.
+     */
+    unsigned getOutputLag() const;
+
+    /**
+     * Changes the delay between the input and the output and causes
+     * a reset. The default (and maximum) is MAX_OUTPUT_LAG, a quarter 
+     * of the longest pitch period (3.75ms). This is the lag assumed 
+     * by G.711 Appendix I. It allows the transition into synthetic 
+     * audio to be blended over real audio that hasn't been played 
+     * yet.
+     *
+     * With a shorter lag good frames come out sooner (with no lag at
+     * all they pass straight through) and the blend is done by fading
+     * the start of the synthetic audio against a time-reversed copy 
+     * of the end of the real audio. This only costs anything when an
+     * erasure starts.
+     *
+     * @param samples 0 to MAX_OUTPUT_LAG
+     */
+    void setOutputLag(unsigned samples);
+
+    /**
+     * @returns true if the pitch is being tracked incrementally.
+     */
+    bool getPitchTracking() const;
+
+    /**
+     * Enables or disables incremental pitch tracking and causes a 
+     * reset. Off by default.
+     *
+     * Normally the complete pitch search is done by the first 
+     * badFrame() of an erasure, which makes that call many times 
+     * more expensive than any other. With tracking on, each 
+     * goodFrame() does its share of the coarse search (the 
+     * correlations against the newest audio) and the first 
+     * badFrame() only has to finish it. This trades a small cost 
+     * on every good frame for a much lower worst case.
+     *
+     * The coarse search is done with exact integer sums so in rare
+     * near-ties the chosen wavelength can differ slightly from the 
+     * one chosen without tracking.
+     */
+    void setPitchTracking(bool on);
+
     /**
      * Returns to the initial state.
      */
     void reset();
 
+    // The number of samples in each frame
+    static constexpr unsigned FRAME_LEN = SampleRate * FrameMs / 1000;
+    // The number of samples of history retained (48.75ms)
+    static constexpr unsigned HIST_LEN = 390 * (SampleRate / 8000);
+    // The default delay between input and output (3.75ms)
+    static constexpr unsigned MAX_OUTPUT_LAG = 30 * (SampleRate / 8000);
+
+    static constexpr uint8_t SNAPSHOT_VERSION = 3;
+
+    /**
+     * A compact, fixed-size (POD) copy of the concealment state. This
+     * can be used to move a live stream between threads or hosts. 
+     * Only the live portion of the state is captured: the pitch 
+     * buffer is only meaningful while an erasure is in progress and
+     * the blend curve is rebuilt from the wavelength on restore.
+     */
+    struct Snapshot {
+        uint8_t version;
+        uint8_t rateKhz;
+        uint8_t frameMs;
+        uint8_t pitchWaveCount;
+        uint32_t erasureCount;
+        uint16_t pitchBufPtr;
+        uint16_t pitchWavelen;
+        uint16_t outputLag;
+        uint8_t backBlendPending;
+        uint8_t backBlendPtr;
+        float attenuationRamp;
+        float attenuationRampDelta;
+        int16_t histBuf[HIST_LEN];
+        int16_t pitchBuf[HIST_LEN];
+    };
+
+    /**
+     * Captures the current state. This is a couple of small copies
+     * so it is cheap enough to call on every frame.
+     */
+    void snapshot(Snapshot& snap) const;
+
+    /**
+     * Replaces the current state with one previously captured by 
+     * snapshot(). Processing after a restore is identical to what 
+     * the original instance would have produced.
+     *
+     * @returns false if the snapshot has the wrong version/format
+     * or is inconsistent, in which case the state is unchanged.
+     */
+    bool restore(const Snapshot& snap);
+
 private:
 
-    // These constants are used to pre-allocate the largest possible work 
-    // ares. They have been scaled assuming a maximum sample rate of 48K.
-    //
-    // IMPORTANT: Must be evenly divisible by 4.
-    static const unsigned MAX_PITCH_PERIOD_LEN = 120 * 6;
-    static const unsigned MAX_HIST_BUF_LEN = MAX_PITCH_PERIOD_LEN * 3.25;
+    static_assert(SampleRate % 8000 == 0 && SampleRate <= 48000, 
+        "Sample rate must be a multiple of 8 kHz up to 48 kHz");
+
+    // All of the Appendix I constants are stated at 8 kHz
+    static constexpr unsigned _rateMult = SampleRate / 8000;
 
     /**
      * Should be called immediately when an erasure (missed block)
@@ -87,17 +208,85 @@ private:
     void _computePitchPeriod();
 
     /**
-     * @returns An interpolated sample from the pitch buffer, including
-     * the logic for smoothing the wrap-around at the end of the 
-     * buffer.
+     * Generates the next len synthetic samples from the pitch buffer,
+     * including the logic for smoothing the wrap-around at the end 
+     * of the buffer and the attenuation.
+     *
+     * The work is done in runs rather than per sample: straight 
+     * copies out of the pitch buffer, the cross-fades, and then a 
+     * single pass for the attenuation.
      * 
      * This has the side-effect of moving the pitch buffer pointer
-     * forward so only call it once per cycle.
+     * forward.
+     *
+     * @param len At most FRAME_LEN
+     */
+    void _synthesize(int16_t* out, unsigned len);
+
+    /**
+     * Pitch tracking: computes the coarse correlations against the
+     * newest audio in the history. Called at the end of goodFrame().
+     */
+    void _trackPitch();
+
+    /**
+     * Fills the blend curve for the current quarter wavelength.
      */
-    int16_t _getSyntheticSample();
+    void _buildBlendCoef();
+
+    /**
+     * Extends the erasure by 10ms and makes the Appendix I state
+     * changes (pitch capture, wavelength count, attenuation) that 
+     * happen at that point.
+     */
+    void _advanceErasure();
+
+    static constexpr float sampleRate = SampleRate;
+    // The number of samples in each frame
+    static constexpr unsigned _frameLen = FRAME_LEN;
+    // The erasure state machine runs in 10ms units
+    static constexpr unsigned _unitLen = SampleRate / 100;
+    static constexpr unsigned _unitsPerFrame = FrameMs / 10;
+    // The period of a 66 Hz pitch - the lowest fundamental
+    // we will track.
+    static constexpr unsigned pitchPeriodMax = 120 * _rateMult; 
+    // The period of a 200 Hz pitch - the highest fundamental
+    // we will track.
+    static constexpr unsigned pitchPeriodMin = 40 * _rateMult; 
+    // The length of the correlation period used when searching for the pitch
+    static constexpr unsigned corrLen = 160 * _rateMult;
+    static constexpr float minPower = 250 * _rateMult;
+    // The fade back into real audio is extended by 4ms for each 
+    // additional 10ms of erasure.
+    static constexpr unsigned _fadeStep = 32 * _rateMult;
+    // History is 48.75 ms. This is 3.25 maximum pitch periods.
+    // (The lowest frequency is 66 Hz, which is 120 samples at 8kHz. 
+    // 120 * 3.25=390)
+    static constexpr unsigned _histBufLen = HIST_LEN;
+    // The pitch buffer is long enough for three complete cycles
+    // at the lowest pitch frequency.
+    static constexpr unsigned _pitchBufLen = _histBufLen;
+
+    // The number of taps tested during the coarse pitch search
+    static constexpr unsigned _coarseTapCount = 
+        (pitchPeriodMax - pitchPeriodMin) / 2 + 1;
+    // Pitch tracking: the length of the newest part of the correlation
+    // window that is handled by goodFrame().
+    static constexpr unsigned _trackLen = 
+        _frameLen < corrLen ? _frameLen : corrLen;
 
-    const float sampleRate = 8000;
-    // The number of consecutive missing frames seen
+    static_assert(pitchPeriodMax % 4 == 0);
+    static_assert(MAX_OUTPUT_LAG == pitchPeriodMax / 4);
+    static_assert(_histBufLen == (pitchPeriodMax * 13) / 4);
+    static_assert(FrameMs % 10 == 0, "Frames must be a multiple of 10ms");
+    static_assert(_frameLen > MAX_OUTPUT_LAG && 
+        _frameLen + MAX_OUTPUT_LAG <= _histBufLen,
+        "Frame size is not supported");
+
+    // The delay in the system as a result of the lag
+    // between input and output.
+    unsigned _outputLag = MAX_OUTPUT_LAG;
+    // The length of the current erasure in 10ms units
     unsigned _erasureCount = 0;
     // Used for creating the down ramp during synthesis. This
     // is the current attenuation level:
@@ -105,48 +294,44 @@ private:
     // This is the amount the attenuation should be adjusted
     // on each sample:
     float _attenuationRampDelta = 0.0;
-
-    // History is 48.75 ms. This is 3.25 maximum pitch periods.
-    // (The lowest frequency is 66 Hz, which is 120 samples at 8kHz. 
-    // 120 * 3.25=390)
-    static const unsigned _histBufLen = 390;
-    int16_t _histBuf[MAX_HIST_BUF_LEN];
-
     // This is used during synthesis. Points to the current
     // synthesized sample. This moves across the pitch 
     // buffer in circular fashion.
     unsigned _pitchBufPtr = 0;
+    // Low-latency mode: set when the synthesis is still playing out
+    // the real audio at the end of the pitch buffer and the
+    // back-blend will start at the first wrap-around.
+    bool _backBlendPending = false;
+    // Set when the coarse pitch search is being done incrementally
+    bool _pitchTracking = false;
+    // Low-latency mode: position in the back-blend. The back-blend 
+    // is running while this is less than _quarterPitchWavelen.
+    unsigned _backBlendPtr = 0;
     // These are set by the pitch determination function.
     // The dominant pitch wavelength in samples
     unsigned _pitchWavelen = 0;
     // 1/4 of above (used a lot)
     unsigned _quarterPitchWavelen = 0;
     // The number of wavelengths in the synthesis. This depends 
-    // on how many erasures have happened so far.
+    // on how long the erasure has been going on.
     unsigned _pitchWaveCount = 1;
-    // The number of samples in each 10ms block at 8kHz
-    const unsigned _frameLen = 80;
-    // The period of a 66 Hz pitch - the lowest fundamental
-    // we will track.
-    static const unsigned pitchPeriodMax = 120; 
-    // The period of a 200 Hz pitch - the highest fundamental
-    // we will track.
-    const unsigned pitchPeriodMin = 40; 
-    // The fixed delay in the system as a result of the lag
-    // between input and output.
-    const unsigned _outputLag = (pitchPeriodMax / 4);
-    // The length of the correlation period used when searching for the pitch
-    const unsigned corrLen = 160;
-    const float minPower = 250;
-    // The pitch buffer is long enough for three complete cycles
-    // at the lowest pitch frequency.
-    static const unsigned _pitchBufLen = 390;
-    int16_t _pitchBuf[MAX_HIST_BUF_LEN];
+
+    int16_t _histBuf[_histBufLen];
+    int16_t _pitchBuf[_pitchBufLen];
     // Holds the blend curve that is used to transition between 
     // discontinuous signals. This buffer goes from 0.0->1.0 so
     // you will need subtract it from 1.0 to produce the ramp-down.
-    float _blendCoef[MAX_PITCH_PERIOD_LEN / 4];
+    float _blendCoef[pitchPeriodMax / 4];
+    // Pitch tracking: the coarse correlation for each tap over the 
+    // last _trackLen samples of the history. Index 0 is the longest
+    // tap (pitchPeriodMax).
+    float _trackCorr[_coarseTapCount];
 };
 
+/**
+ * The standard 8 kHz/10ms PLC.
+ */
+using Plc = BasicPlc<8000, 10>;
+
 }
 
@@ -0,0 +1,53 @@
+/**
+ * ITU G.711 Appendix 1 PLC Algorithm
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+
+#include "itu-g711-plc/Plc.h"
+
+namespace kc1fsz {
+
+/**
+ * Offline packet loss concealment for a complete recording.
+ *
+ * The output is bit-identical to running a single Plc over the
+ * recording from start to finish, but the work is split up and run
+ * on multiple threads. This works because the PLC state is completely
+ * determined by the input after a long enough run of good frames
+ * (apart from the number of pitch periods used in the synthesis, 
+ * which is easily tracked from the loss map). So each run of that 
+ * length is a place where the recording can be split and a new Plc 
+ * primed with the preceding audio.
+ *
+ * @param pcm The decoded recording, frameCount * Plc::FRAME_LEN 
+ *   samples. The contents of the lost frames are ignored.
+ * @param lossMap One bit per frame, set if the frame was lost. Bit 0
+ *   of byte 0 is the first frame.
+ * @param frameCount The number of 10ms frames in the recording.
+ * @param out Receives frameCount * Plc::FRAME_LEN samples. This is 
+ *   delayed by outputLag samples, the same as a Plc would be.
+ * @param threadCount The number of worker threads, or 0 to use 
+ *   one per core.
+ * @param outputLag See Plc::setOutputLag().
+ */
+void repairRecording(const int16_t* pcm, const uint8_t* lossMap,
+    unsigned frameCount, int16_t* out, unsigned threadCount = 0,
+    unsigned outputLag = Plc::MAX_OUTPUT_LAG);
+
+}
@@ -0,0 +1,233 @@
+/**
+ * ITU G.711 Appendix 1 PLC Algorithm
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <bit>
+
+#include "itu-g711-plc/Plc.h"
+
+namespace kc1fsz {
+
+/**
+ * A fixed-capacity pool of per-stream PLC slots that is shared
+ * between signaling threads (which add and remove streams) and a
+ * single media thread (which runs the audio every tick).
+ *
+ * - acquire() and release() are lock-free and can be called from
+ *   any thread.
+ * - The media thread calls beginTick() at the start of each tick and
+ *   then visits the active streams with forEachActive(). Streams are
+ *   visited in slot order which keeps memory access sequential.
+ * - acquire() and release() push the slot onto lock-free join/leave
+ *   lists which beginTick() takes over in one step each. The cost of
+ *   beginTick() is proportional to the number of membership changes
+ *   since the last tick, and the active set is kept in a dense
+ *   bitmap, so the slots themselves are only touched when they
+ *   change or are visited.
+ * - Each tick is an epoch. The media thread only touches slots
+ *   between beginTick() and the end of the tick, so beginTick() is
+ *   the point where everything released during the previous epoch
+ *   can be reclaimed. A release that arrives while the media thread
+ *   is in the middle of a tick is therefore always safe.
+ * - Slots are cache-line aligned so there is no false sharing
+ *   between adjacent streams.
+ *
+ * There is no dynamic memory allocation. This object is large
+ * (Capacity * sizeof(Slot)) so create it once at startup in static
+ * storage or on the heap.
+ *
+ * @tparam Capacity The maximum number of concurrent streams.
+ * @tparam PlcT Any of the BasicPlc configurations.
+ */
+template<unsigned Capacity, typename PlcT = Plc> class StreamRegistry {
+public:
+
+    static constexpr unsigned CACHE_LINE = 64;
+
+    struct alignas(CACHE_LINE) Slot {
+        PlcT plc;
+        // Application identifier (call ID, etc.)
+        uint64_t tag = 0;
+    private:
+        friend class StreamRegistry;
+        std::atomic<uint32_t> state { FREE };
+        // Free list link
+        std::atomic<uint32_t> next { NONE };
+        // Join/leave list links. These are separate since a stream
+        // can join and leave between two ticks.
+        uint32_t joinNext = NONE;
+        uint32_t leaveNext = NONE;
+    };
+
+    StreamRegistry() {
+        // All slots start out on the free list, in order
+        for (unsigned i = 0; i < Capacity; i++)
+            _slots[i].next.store(i + 1 < Capacity ? i + 1 : NONE,
+                std::memory_order_relaxed);
+        _freeHead.store(_pack(0, 0));
+    }
+
+    StreamRegistry(const StreamRegistry&) = delete;
+    StreamRegistry& operator=(const StreamRegistry&) = delete;
+
+    /**
+     * Allocates a slot for a new stream and resets its PLC. Safe to
+     * call from any thread. The stream will be visited by the media
+     * thread starting with the next tick.
+     *
+     * @returns The slot index, or -1 if the registry is full.
+     */
+    int acquire(uint64_t tag) {
+        uint64_t head = _freeHead.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t index = _index(head);
+            if (index == NONE)
+                return -1;
+            uint32_t next = _slots[index].next.load(std::memory_order_relaxed);
+            // The counter in the top half prevents ABA problems
+            if (_freeHead.compare_exchange_weak(head,
+                _pack(next, _count(head) + 1),
+                std::memory_order_acq_rel, std::memory_order_acquire))
+                break;
+        }
+        Slot& slot = _slots[_index(head)];
+        assert(slot.state.load() == FREE);
+        slot.plc.reset();
+        slot.tag = tag;
+        slot.state.store(ACTIVE, std::memory_order_release);
+        _push(_joined, _index(head), &Slot::joinNext);
+        return _index(head);
+    }
+
+    /**
+     * Removes a stream. Safe to call from any thread, including the
+     * media thread in the middle of a tick.
+     */
+    void release(unsigned index) {
+        assert(index < Capacity);
+        Slot& slot = _slots[index];
+        uint32_t expected = ACTIVE;
+        bool ok = slot.state.compare_exchange_strong(expected, RETIRED,
+            std::memory_order_acq_rel);
+        assert(ok);
+        (void)ok;
+        _push(_left, index, &Slot::leaveNext);
+    }
+
+    Slot& get(unsigned index) {
+        assert(index < Capacity);
+        return _slots[index];
+    }
+
+    /**
+     * Media thread only. Starts a new epoch, returns retired slots
+     * to the free list and picks up membership changes.
+     */
+    void beginTick() {
+        // The leave list is taken first. A stream's join is always
+        // pushed before its leave, so every stream on this leave
+        // list has its join on this join list or an earlier one.
+        uint32_t left = _left.exchange(NONE, std::memory_order_acq_rel);
+        uint32_t joined = _joined.exchange(NONE, std::memory_order_acq_rel);
+        for (uint32_t i = joined; i != NONE; i = _slots[i].joinNext) {
+            _activeBits[i / 64] |= (uint64_t)1 << (i % 64);
+            _activeCount++;
+        }
+        while (left != NONE) {
+            uint32_t i = left;
+            left = _slots[i].leaveNext;
+            _activeBits[i / 64] &= ~((uint64_t)1 << (i % 64));
+            _activeCount--;
+            // This was released during an earlier epoch and the
+            // media thread isn't holding on to it any longer.
+            _free(i);
+        }
+    }
+
+    /**
+     * Media thread only. Calls f(index, slot) for each of the streams
+     * that were active at the start of the tick.
+     */
+    template<typename F> void forEachActive(F f) {
+        for (unsigned w = 0; w < _wordCount; w++) {
+            for (uint64_t bits = _activeBits[w]; bits != 0; bits &= bits - 1) {
+                unsigned i = w * 64 + std::countr_zero(bits);
+                f(i, _slots[i]);
+            }
+        }
+    }
+
+    /**
+     * Media thread only. The number of streams visited this tick.
+     */
+    unsigned activeCount() const { return _activeCount; }
+
+private:
+
+    static constexpr uint32_t FREE = 0;
+    static constexpr uint32_t ACTIVE = 1;
+    static constexpr uint32_t RETIRED = 2;
+    static constexpr uint32_t NONE = 0xffffffff;
+
+    static uint64_t _pack(uint32_t index, uint32_t count) {
+        return ((uint64_t)count << 32) | index;
+    }
+    static uint32_t _index(uint64_t v) { return v & 0xffffffff; }
+    static uint32_t _count(uint64_t v) { return v >> 32; }
+
+    /**
+     * Pushes a slot onto a join/leave list. Lists are only ever
+     * taken as a whole (exchange) so there is no ABA problem.
+     */
+    void _push(std::atomic<uint32_t>& list, uint32_t index,
+        uint32_t Slot::* link) {
+        uint32_t head = list.load(std::memory_order_relaxed);
+        do {
+            _slots[index].*link = head;
+        } while (!list.compare_exchange_weak(head, index,
+            std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    void _free(unsigned index) {
+        Slot& slot = _slots[index];
+        slot.state.store(FREE, std::memory_order_relaxed);
+        uint64_t head = _freeHead.load(std::memory_order_acquire);
+        do {
+            slot.next.store(_index(head), std::memory_order_relaxed);
+        } while (!_freeHead.compare_exchange_weak(head,
+            _pack(index, _count(head) + 1),
+            std::memory_order_acq_rel, std::memory_order_acquire));
+    }
+
+    // Everything that is shared between threads is on its own line
+    alignas(CACHE_LINE) std::atomic<uint64_t> _freeHead;
+    alignas(CACHE_LINE) std::atomic<uint32_t> _joined { NONE };
+    alignas(CACHE_LINE) std::atomic<uint32_t> _left { NONE };
+
+    // Media thread only
+    static constexpr unsigned _wordCount = (Capacity + 63) / 64;
+    alignas(CACHE_LINE) unsigned _activeCount = 0;
+    uint64_t _activeBits[_wordCount] = { 0 };
+
+    Slot _slots[Capacity];
+};
+
+}
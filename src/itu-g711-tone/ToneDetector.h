@@ -0,0 +1,120 @@
+/**
+ * ITU G.711 CODEC
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * NOT FOR COMMERCIAL USE WITHOUT PERMISSION.
+ */
+#ifndef _g711_tone_detector_h
+#define _g711_tone_detector_h
+
+#include <cstdint>
+
+namespace kc1fsz {
+
+/**
+ * DTMF and call-progress tone detection directly on 8 kHz G.711 uLaw
+ * frames.
+ *
+ * All of the tones (the 8 DTMF frequencies plus up to 8 configurable
+ * ones) are tracked with a bank of Goertzel filters that are updated
+ * together. The filter bank is laid out as fixed-size arrays so the 
+ * compiler can vectorize the update across the tones.
+ *
+ * The detector object holds the (shared) configuration and each
+ * stream has its own small fixed-size State. There is no dynamic
+ * memory allocation.
+ */
+class ToneDetector {
+public:
+
+    // 8 DTMF + 8 configurable
+    static const unsigned MAX_TONES = 16;
+    static const unsigned DTMF_TONES = 8;
+    // The Goertzel block length, the usual choice for DTMF at 8 kHz
+    // (25.6ms)
+    static const unsigned BLOCK_LEN = 205;
+
+    /**
+     * The per-stream state. The results are updated at the end of
+     * each block.
+     */
+    struct State {
+        float s1[MAX_TONES];
+        float s2[MAX_TONES];
+        float energy;
+        unsigned count;
+        // The DTMF digit detected in the last block ('0'-'9', '*', 
+        // '#', 'A'-'D') or 0 if none
+        char digit;
+        // Bit n is set if configurable tone n was present in the
+        // last block
+        uint16_t tones;
+    };
+
+    ToneDetector();
+
+    /**
+     * Adds a tone (for example 350 and 440 Hz for a North American
+     * dial tone) to the detector.
+     *
+     * @returns The bit in State::tones that will indicate the 
+     * tone, or -1 if there is no more room.
+     */
+    int addTone(float hz);
+
+    /**
+     * Prepares the state for a new stream.
+     */
+    void resetState(State& state) const;
+
+    /**
+     * Processes a frame of uLaw audio for one stream.
+     *
+     * @returns true if a block was completed during the frame (and 
+     * so the results in the state have been updated).
+     */
+    bool process(State& state, const uint8_t* ulaw, unsigned len) const;
+
+    /**
+     * Processes one frame for each of a group of streams.
+     *
+     * @param states One state per stream.
+     * @param frames One uLaw frame per stream, each len samples.
+     * @param completed Optional, one flag per stream that is set
+     *   to indicate that the results were updated.
+     */
+    void processBatch(State* states, const uint8_t* const* frames,
+        unsigned streamCount, unsigned len, bool* completed = nullptr) const;
+
+private:
+
+    /**
+     * Runs the Goertzel filter bank over some PCM samples.
+     */
+    void _update(State& state, const int16_t* pcm, unsigned len) const;
+
+    /**
+     * Makes the DTMF/tone decisions at the end of a block.
+     */
+    void _decide(State& state) const;
+
+    float _coef[MAX_TONES];
+    unsigned _toneCount = DTMF_TONES;
+};
+
+}
+
+#endif
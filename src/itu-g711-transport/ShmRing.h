@@ -0,0 +1,362 @@
+/**
+ * ITU G.711 Frame Transport
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+
+#include "itu-g711-codec/codec.h"
+
+namespace kc1fsz {
+
+/**
+ * Moves audio frames between processes on the same host through
+ * shared memory, without any copies through the kernel.
+ *
+ * The region holds any number of streams. Each stream is a
+ * single-producer/single-consumer ring of fixed-size slots, so one
+ * process (e.g. the receiver) writes a stream and one other process
+ * (e.g. the conceal/mix process) reads it. Each slot carries the
+ * frame sequence number, a lost flag and the payload (uLaw or 16-bit
+ * PCM). The producer can write the payload directly into the slot
+ * and the consumer can read it in place.
+ *
+ * The consumer can poll, or it can sleep in wait() until a producer
+ * calls notify(). The wakeup uses a futex in the shared region so
+ * there is no system call when nobody is waiting.
+ *
+ * The region is created by one process with create() (either as a
+ * named POSIX shared memory object or as an anonymous memfd) and
+ * mapped by the others with open(). There is no dynamic memory
+ * allocation after that. This is Linux-only.
+ */
+class ShmRing {
+public:
+
+    // The payload is 16-bit PCM (native byte order) rather than uLaw
+    static constexpr unsigned FLAG_PCM = 0x01;
+    // The frame was lost upstream. There is no payload.
+    static constexpr unsigned FLAG_LOST = 0x02;
+
+    /**
+     * A frame that is ready to be consumed. The data points directly
+     * into the shared region and is valid until pop() is called.
+     */
+    struct View {
+        uint32_t seq;
+        // In samples
+        unsigned len;
+        unsigned flags;
+        const uint8_t* data;
+    };
+
+    ShmRing();
+    ~ShmRing();
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    /**
+     * Creates and maps a new region. All of the streams start out
+     * empty.
+     *
+     * @param name The POSIX shared memory name (i.e. "/g711-rx"), or
+     *   nullptr to create an anonymous memfd. The memfd can be shared
+     *   with fork() or by passing getFd() over a Unix socket.
+     * @param streamCount The number of streams.
+     * @param slotCount The number of slots in each stream, a power
+     *   of two.
+     * @param maxSamples The largest frame (in samples) that a slot
+     *   can hold. PCM frames use two bytes per sample.
+     * @returns false if the region can't be created.
+     */
+    bool create(const char* name, unsigned streamCount, unsigned slotCount,
+        unsigned maxSamples);
+
+    /**
+     * Maps a region that was created by another process.
+     * @returns false if it doesn't exist or isn't a valid region.
+     */
+    bool open(const char* name);
+
+    /**
+     * Maps a region from a descriptor (e.g. an inherited memfd). The
+     * descriptor is duplicated so the caller still owns it.
+     */
+    bool open(int fd);
+
+    /**
+     * Unmaps the region. Named regions persist until unlink().
+     */
+    void close();
+
+    /**
+     * Removes a named region. Processes that have it mapped are not
+     * affected.
+     */
+    static void unlink(const char* name);
+
+    bool isOpen() const { return _base != nullptr; }
+    int getFd() const { return _fd; }
+    unsigned getStreamCount() const { return _streamCount; }
+    unsigned getSlotCount() const { return _slotCount; }
+    unsigned getMaxSamples() const { return _maxSamples; }
+
+    // ----- Producer side ---------------------------------------------
+
+    /**
+     * @returns A pointer to the payload area of the next free slot
+     *   (getMaxSamples() * 2 bytes), or nullptr if the stream is full.
+     *   Nothing is visible to the consumer until commitWrite().
+     */
+    uint8_t* beginWrite(unsigned stream) {
+        Stream& s = _streams[stream];
+        uint32_t head = s.head.load(std::memory_order_relaxed);
+        if (head - s.tail.load(std::memory_order_acquire) == _slotCount)
+            return nullptr;
+        return _slot(stream, head) + sizeof(SlotHeader);
+    }
+
+    /**
+     * Publishes the slot returned by the last beginWrite().
+     *
+     * @param len The number of samples in the payload, up to 
+     *   getMaxSamples().
+     * @returns false if len is too long, in which case nothing is
+     *   published.
+     */
+    bool commitWrite(unsigned stream, uint32_t seq, unsigned len,
+        unsigned flags) {
+        if (len > _maxSamples)
+            return false;
+        Stream& s = _streams[stream];
+        uint32_t head = s.head.load(std::memory_order_relaxed);
+        SlotHeader* h = (SlotHeader*)_slot(stream, head);
+        h->seq = seq;
+        h->len = len;
+        h->flags = flags;
+        s.head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Copies a frame into the next slot.
+     * @returns false if the stream is full or the frame is longer
+     *   than getMaxSamples() (the frame is dropped).
+     */
+    bool write(unsigned stream, uint32_t seq, const void* data,
+        unsigned len, unsigned flags) {
+        if (len > _maxSamples)
+            return false;
+        uint8_t* p = beginWrite(stream);
+        if (p == nullptr)
+            return false;
+        if ((flags & FLAG_LOST) == 0)
+            memcpy(p, data, len * ((flags & FLAG_PCM) ? 2 : 1));
+        return commitWrite(stream, seq, len, flags);
+    }
+
+    /**
+     * Wakes the consumer if it is sleeping in wait(). Call this once
+     * after a batch of writes.
+     */
+    void notify();
+
+    // ----- Consumer side ---------------------------------------------
+
+    /**
+     * Looks at the oldest frame in a stream without removing it.
+     * @returns false if the stream is empty.
+     */
+    bool peek(unsigned stream, View& view) const {
+        const Stream& s = _streams[stream];
+        uint32_t tail = s.tail.load(std::memory_order_relaxed);
+        if (s.head.load(std::memory_order_acquire) == tail)
+            return false;
+        const SlotHeader* h = (const SlotHeader*)_slot(stream, tail);
+        view.seq = h->seq;
+        view.len = h->len;
+        view.flags = h->flags;
+        view.data = (const uint8_t*)h + sizeof(SlotHeader);
+        return true;
+    }
+
+    /**
+     * Releases the oldest frame in a stream back to the producer.
+     */
+    void pop(unsigned stream) {
+        Stream& s = _streams[stream];
+        s.tail.store(s.tail.load(std::memory_order_relaxed) + 1,
+            std::memory_order_release);
+    }
+
+    /**
+     * @returns The number of frames waiting in a stream.
+     */
+    unsigned available(unsigned stream) const {
+        const Stream& s = _streams[stream];
+        return s.head.load(std::memory_order_acquire) -
+            s.tail.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Sleeps until a producer calls notify() or the timeout expires.
+     * This returns immediately if there has been a notify() since
+     * the one that produced lastEvent. A typical loop is:
+     *
+     *   uint32_t ev = ring.getEvent();
+     *   while (true) {
+     *       ... drain all of the streams ...
+     *       ev = ring.wait(ev, 20);
+     *   }
+     *
+     * @param timeoutMs 0 to wait forever.
+     * @returns The current event counter.
+     */
+    uint32_t wait(uint32_t lastEvent, unsigned timeoutMs);
+
+    /**
+     * @returns The current event counter (see wait()).
+     */
+    uint32_t getEvent() const;
+
+private:
+
+    static constexpr uint32_t MAGIC = 0x31313747;
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t CACHE_LINE = 64;
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free,
+        "The shared counters must be address-free");
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t streamCount;
+        uint32_t slotCount;
+        uint32_t maxSamples;
+        uint32_t slotLen;
+        uint64_t regionLen;
+        // Bumped by notify(), this is the futex word
+        alignas(CACHE_LINE) std::atomic<uint32_t> event;
+        std::atomic<uint32_t> waiters;
+    };
+
+    // The producer and consumer indexes are on separate lines
+    struct Stream {
+        alignas(CACHE_LINE) std::atomic<uint32_t> head;
+        alignas(CACHE_LINE) std::atomic<uint32_t> tail;
+    };
+
+    struct SlotHeader {
+        uint32_t seq;
+        uint16_t len;
+        uint8_t flags;
+        uint8_t reserved;
+    };
+
+    static size_t _slotLenFor(unsigned maxSamples);
+    static size_t _regionLenFor(unsigned streamCount, unsigned slotCount,
+        unsigned maxSamples);
+    bool _map(int fd, bool init, unsigned streamCount, unsigned slotCount,
+        unsigned maxSamples);
+
+    uint8_t* _slot(unsigned stream, uint32_t index) const {
+        return _slots +
+            ((size_t)stream * _slotCount + (index & (_slotCount - 1))) * _slotLen;
+    }
+
+    int _fd = -1;
+    uint8_t* _base = nullptr;
+    size_t _len = 0;
+    Header* _header = nullptr;
+    Stream* _streams = nullptr;
+    uint8_t* _slots = nullptr;
+    unsigned _streamCount = 0;
+    unsigned _slotCount = 0;
+    unsigned _maxSamples = 0;
+    size_t _slotLen = 0;
+};
+
+/**
+ * Consumer side helper that produces exactly one frame of audio for
+ * a stream from the ring, using the PLC to fill in whenever the
+ * expected frame is missing. Call this once per tick for each stream.
+ *
+ * - A frame with the expected sequence number is decoded (if it's
+ *   uLaw) and passed to goodFrame().
+ * - A frame marked as lost, a late/missing frame (the ring is
+ *   empty) or a gap in the sequence numbers results in badFrame().
+ *   After a gap the early frame stays in the ring until its turn.
+ * - Stale (older than expected) frames are discarded.
+ * - A jump of more than getSlotCount() in either direction (i.e. the
+ *   producer restarted) is treated as a new stream: the frame is 
+ *   used and nextSeq continues from it.
+ *
+ * The payload is consumed in place before the slot is released. The
+ * length in the slot comes from another process so a frame is only 
+ * used if it is exactly one PLC frame and fits in a slot.
+ *
+ * @param nextSeq The sequence number that is expected, advanced by
+ *   one on every call.
+ * @returns true if real audio was received.
+ */
+template<typename PlcT> bool receiveFrame(ShmRing& ring, unsigned stream,
+    PlcT& plc, int16_t* out, uint32_t& nextSeq) {
+
+    const unsigned frameLen = PlcT::FRAME_LEN;
+    const bool fits = frameLen <= ring.getMaxSamples();
+    const int32_t window = ring.getSlotCount();
+    bool good = false;
+    ShmRing::View v;
+    while (ring.peek(stream, v)) {
+        int32_t diff = (int32_t)(v.seq - nextSeq);
+        // Resynchronize
+        if (diff > window || diff < -window) {
+            nextSeq = v.seq;
+            diff = 0;
+        }
+        // Early, leave it for later
+        if (diff > 0)
+            break;
+        // Stale or duplicate
+        if (diff < 0) {
+            ring.pop(stream);
+            continue;
+        }
+        if (fits && (v.flags & ShmRing::FLAG_LOST) == 0 && v.len == frameLen) {
+            if (v.flags & ShmRing::FLAG_PCM)
+                plc.goodFrame((const int16_t*)v.data, out, frameLen);
+            else {
+                decode_ulaw_block(v.data, out, frameLen);
+                plc.goodFrame(out, out, frameLen);
+            }
+            good = true;
+        }
+        ring.pop(stream);
+        break;
+    }
+    if (!good)
+        plc.badFrame(out, frameLen);
+    nextSeq++;
+    return good;
+}
+
+}
@@ -0,0 +1,114 @@
+/**
+ * ITU G.711 Appendix 1 PLC Algorithm
+ * Copyright (C) 2025, Bruce MacKinnon 
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include "itu-g711-codec/codec.h"
+#include "itu-g711-codec/G711FileReader.h"
+#include "itu-g711-plc/Repair.h"
+
+using namespace std;
+using namespace kc1fsz;
+
+/*
+A command-line utility for repairing a G711 ulaw recording (raw
+or WAV) that has lost frames. The loss map has one bit per 10ms
+frame (bit 0 of byte 0 is the first frame) that is set if the 
+frame was lost. The result is written as raw ulaw. The work is 
+spread across all cores.
+
+The output is delayed by the PLC output lag (30 samples by default,
+use -l 0 for none).
+
+./repair [-t threads] [-l lag] recording.wav recording.loss repaired.bin
+*/
+int main(int argc,const char** argv) {
+
+    unsigned threads = 0;
+    unsigned lag = Plc::MAX_OUTPUT_LAG;
+    vector<string> names;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if (a == "-t" && i + 1 < argc)
+            threads = stoul(argv[++i]);
+        else if (a == "-l" && i + 1 < argc)
+            lag = std::min((unsigned long)Plc::MAX_OUTPUT_LAG, stoul(argv[++i]));
+        else
+            names.push_back(a);
+    }
+    if (names.size() < 3) {
+        cout << "Argument error" << endl;
+        return -1;
+    }
+
+    G711FileReader reader;
+    if (!reader.open(names[0].c_str()) || reader.getSampleRate() != 8000) {
+        cout << "Unable to open: " << names[0] << endl;
+        return -1;
+    }
+    ifstream lossFile(names[1], ios::binary);
+    if (!lossFile) {
+        cout << "Unable to open: " << names[1] << endl;
+        return -1;
+    }
+    vector<uint8_t> lossMap((istreambuf_iterator<char>(lossFile)), 
+        istreambuf_iterator<char>());
+
+    const unsigned frameLen = Plc::FRAME_LEN;
+    const uint64_t sampleCount = reader.getSampleCount();
+    const unsigned frameCount = sampleCount / frameLen;
+    // Anything past the end of the map is assumed to be good
+    lossMap.resize(std::max((size_t)(frameCount / 8 + 1), lossMap.size()), 0);
+
+    span<const uint8_t> in = reader.encoded(0, 
+        (sampleCount * 1000) / reader.getSampleRate() + 1);
+    vector<int16_t> pcm(frameCount * frameLen);
+    vector<int16_t> repaired(frameCount * frameLen);
+    decode_ulaw_block(in.data(), pcm.data(), pcm.size());
+
+    repairRecording(pcm.data(), lossMap.data(), frameCount, 
+        repaired.data(), threads, lag);
+
+    vector<uint8_t> out(in.size());
+    for (unsigned i = 0; i < repaired.size(); i++)
+        out[i] = encode_ulaw(repaired[i]);
+    // A partial frame at the end is passed through
+    for (size_t i = repaired.size(); i < in.size(); i++)
+        out[i] = in[i];
+
+    ofstream outfile(names[2], ios::binary);
+    outfile.write((const char*)out.data(), out.size());
+    if (!outfile) {
+        cout << "Unable to write: " << names[2] << endl;
+        return -1;
+    }
+
+    unsigned lostCount = 0;
+    for (unsigned j = 0; j < frameCount; j++)
+        lostCount += (lossMap[j / 8] >> (j % 8)) & 1;
+
+    cout << "Writing to: " << names[2] << endl;
+    cout << "Frames    : " << frameCount << endl;
+    cout << "Repaired  : " << lostCount << endl;
+
+    return 0;
+}
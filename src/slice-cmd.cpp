@@ -0,0 +1,75 @@
+/**
+ * ITU G.711 CODEC
+ * Copyright (C) 2025, Bruce MacKinnon 
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * NOT FOR COMMERCIAL USE WITHOUT PERMISSION.
+ */
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include "itu-g711-codec/G711FileReader.h"
+
+using namespace std;
+using namespace kc1fsz;
+
+/*
+A command-line utility for pulling a time slice out of a (potentially
+very large) G711 ulaw recording, raw or WAV, into PCM text data. Only 
+the requested part of the file is read.
+
+Extract 0.25 seconds starting 0.5 seconds into the recording:
+
+./slice ../tests/clip-7-g711-ulaw.bin 500 250 ../tests/slice-pcm.txt 
+*/
+int main(int argc,const char** argv) {
+
+    if (argc < 5) {
+        cout << "Argument error" << endl;
+        return -1;
+    }
+
+    G711FileReader reader;
+    if (!reader.open(argv[1])) {
+        cout << "Unable to open: " << argv[1] << endl;
+        return -1;
+    }
+
+    uint64_t startMs = stoull(argv[2]);
+    uint64_t lengthMs = stoull(argv[3]);
+    ofstream outfile(argv[4]);
+
+    // Work through the window in blocks to keep memory bounded
+    const unsigned blockMs = 1000;
+    int16_t block[48 * blockMs];
+    unsigned count = 0;
+    for (uint64_t ms = 0; ms < lengthMs; ms += blockMs) {
+        unsigned n = reader.decode(startMs + ms, 
+            std::min((uint64_t)blockMs, lengthMs - ms), block, 
+            sizeof(block) / sizeof(int16_t));
+        for (unsigned i = 0; i < n; i++)
+            outfile << block[i] << endl;
+        count += n;
+        if (n == 0)
+            break;
+    }
+
+    cout << "Writing to: " << argv[4] << endl;
+    cout << "Samples   : " << count << endl;
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#include "itu-g711-codec/codec.h"
+#include "itu-g711-plc/Plc.h"
+#include "itu-g711-pipeline/Pipeline.h"
+
+using namespace std;
+using namespace kc1fsz;
+
+/*
+Demonstrates the pipeline API by running the same uLaw -> PLC -> uLaw 
+processing two ways: with a hand-written loop (like demo-1) and 
+with pipeline stages. Both use the same decoder/encoder and work 
+directly on the input and output streams, so the difference is the
+overhead of the stages. Each is run several times and the fastest 
+time per frame is shown.
+*/
+
+static const unsigned frameLen = 80;
+static const unsigned frameCount = 100 * 60;
+static const unsigned trials = 20;
+static uint8_t inStream[frameLen * frameCount];
+static uint8_t outStream[frameLen * frameCount];
+static uint8_t handStream[frameLen * frameCount];
+
+static bool isErased(unsigned j) {
+    return (j % 50) == 7 || (j % 50) == 8 || (j % 37) == 0;
+}
+
+static double handLoop() {
+    Plc plc;
+    auto start = chrono::steady_clock::now();
+    for (unsigned j = 0; j < frameCount; j++) {
+        int16_t pcm[frameLen];
+        if (isErased(j))
+            plc.badFrame(pcm, frameLen);
+        else {
+            decode_ulaw_block(&inStream[j * frameLen], pcm, frameLen);
+            plc.goodFrame(pcm, pcm, frameLen);
+        }
+        for (unsigned i = 0; i < frameLen; i++)
+            handStream[j * frameLen + i] = encode_ulaw(pcm[i]);
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, micro>(end - start).count() / frameCount;
+}
+
+static double pipeline() {
+
+    typedef Frame<frameLen> FrameT;
+    static FramePool<FrameT, 2> pool;
+    Plc plc;
+    unsigned j = 0;
+
+    // Build the pipeline from the end back to the start
+    auto out = [&j](const FrameT& f) {
+        for (unsigned i = 0; i < f.len; i++)
+            outStream[j * frameLen + i] = f.ulaw[i];
+    };
+    SinkStage<FrameT, 2, decltype(out)> sink(pool, out);
+    EncodeStage<FrameT, decltype(sink)> encode(sink);
+    PlcStage<FrameT, Plc, decltype(encode)> conceal(plc, encode);
+    DecodeStage<FrameT, decltype(conceal)> decode(conceal);
+
+    auto start = chrono::steady_clock::now();
+    for (j = 0; j < frameCount; j++) {
+        FrameT* f = pool.acquire();
+        f->len = frameLen;
+        f->erased = isErased(j);
+        if (!f->erased)
+            for (unsigned i = 0; i < frameLen; i++)
+                f->ulaw[i] = inStream[j * frameLen + i];
+        decode.push(f);
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, micro>(end - start).count() / frameCount;
+}
+
+int main(int,const char**) {
+
+    float omega = 2 * 3.14156 * 220 / 8000;
+    float phi = 0;
+    for (unsigned i = 0; i < frameLen * frameCount; i++) {
+        inStream[i] = encode_ulaw(0.3 * 32767.0f * 
+            (std::cos(phi) + 0.5 * std::cos(3.1 * phi)));
+        phi += omega;
+    }
+
+    double hand = 1e9, pipe = 1e9;
+    for (unsigned t = 0; t < trials; t++) {
+        hand = std::min(hand, handLoop());
+        pipe = std::min(pipe, pipeline());
+    }
+    if (memcmp(handStream, outStream, sizeof(outStream)) != 0) {
+        cout << "Outputs are different" << endl;
+        return -1;
+    }
+
+    cout << "Hand-written loop: " << hand << " us/frame" << endl;
+    cout << "Pipeline         : " << pipe << " us/frame" << endl;
+    cout << "Difference       : " << (pipe - hand) << " us/frame (" 
+         << 100.0 * (pipe - hand) / hand << "%)" << endl;
+    return 0;
+}
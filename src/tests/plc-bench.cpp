@@ -0,0 +1,389 @@
+/**
+ * ITU G.711 Appendix 1 PLC Algorithm
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <numbers>
+#include <algorithm>
+
+#include "itu-g711-plc/Plc.h"
+
+using namespace std;
+using namespace kc1fsz;
+
+/*
+Packet loss quality/cost benchmark for the PLC.
+
+A clean recording is run through the PLC with frames dropped according
+to a loss model. The output is compared against the clean reference
+and compared with the trivial approach of playing silence. The lost
+frames and the first good frame after each erasure are scored.
+
+Usage:
+
+./plc-bench [-m model] [-s seed] [-r repeats] [-l lag] [-p] <input.wav|input.txt>
+
+Input is 8 kHz 16-bit mono PCM either as a WAV file or as text (one
+sample per line, like ../tests/clip-7-pcm.txt).
+
+Loss models:
+
+  bernoulli:P        Each frame is lost with probability P (default 0.1)
+  ge:P,R             Gilbert-Elliott bursts. P is the probability of
+                     moving good->bad and R is bad->good. All frames
+                     are lost in the bad state.
+  trace:FILE         One character per frame, '1' or 'x' is a loss
+
+The -l option sets the PLC output lag in samples (0 to 30, see
+Plc::setOutputLag()). The -p option turns on incremental pitch 
+tracking (see Plc::setPitchTracking()).
+
+Along with the average cost, the median and 99.9th percentile time 
+of a single call are reported since the per-tick deadline depends 
+on the worst case. The single-call times include the overhead of
+reading the clock.
+
+For example:
+
+./plc-bench -m ge:0.05,0.4 ../tests/clip-7-pcm.wav
+*/
+
+static const unsigned frameLen = Plc::FRAME_LEN;
+static const float sampleRate = 8000;
+
+static bool loadPcm(const string& fn, vector<int16_t>& pcm) {
+    if (fn.size() > 4 && fn.substr(fn.size() - 4) == ".txt") {
+        ifstream in(fn);
+        if (!in)
+            return false;
+        string line;
+        while (getline(in, line))
+            if (!line.empty())
+                pcm.push_back(stoi(line));
+        return true;
+    }
+    ifstream in(fn, ios::binary);
+    if (!in)
+        return false;
+    vector<uint8_t> b((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if (b.size() < 12 || memcmp(&b[0], "RIFF", 4) != 0 || memcmp(&b[8], "WAVE", 4) != 0)
+        return false;
+    size_t p = 12;
+    bool formatOk = false;
+    while (p + 8 <= b.size()) {
+        uint32_t len = b[p + 4] | (b[p + 5] << 8) | (b[p + 6] << 16) | (b[p + 7] << 24);
+        if (memcmp(&b[p], "fmt ", 4) == 0 && p + 24 <= b.size()) {
+            unsigned tag = b[p + 8] | (b[p + 9] << 8);
+            unsigned channels = b[p + 10] | (b[p + 11] << 8);
+            unsigned rate = b[p + 12] | (b[p + 13] << 8) | (b[p + 14] << 16);
+            unsigned bits = b[p + 22] | (b[p + 23] << 8);
+            formatOk = tag == 1 && channels == 1 && rate == 8000 && bits == 16;
+        }
+        else if (memcmp(&b[p], "data", 4) == 0) {
+            if (!formatOk)
+                return false;
+            size_t end = std::min(b.size(), p + 8 + len);
+            for (size_t i = p + 8; i + 1 < end; i += 2)
+                pcm.push_back((int16_t)(b[i] | (b[i + 1] << 8)));
+            return true;
+        }
+        p += 8 + len + (len & 1);
+    }
+    return false;
+}
+
+/**
+ * Builds the per-frame loss pattern.
+ */
+static bool makeLossPattern(const string& model, unsigned seed,
+    unsigned frameCount, vector<bool>& lost) {
+
+    mt19937 rng(seed);
+    uniform_real_distribution<float> uniform(0, 1);
+    lost.resize(frameCount);
+
+    if (model.rfind("bernoulli:", 0) == 0) {
+        float p = stof(model.substr(10));
+        for (unsigned j = 0; j < frameCount; j++)
+            lost[j] = uniform(rng) < p;
+    }
+    else if (model.rfind("ge:", 0) == 0) {
+        size_t comma = model.find(',');
+        if (comma == string::npos)
+            return false;
+        float p = stof(model.substr(3, comma - 3));
+        float r = stof(model.substr(comma + 1));
+        bool bad = false;
+        for (unsigned j = 0; j < frameCount; j++) {
+            bad = bad ? (uniform(rng) >= r) : (uniform(rng) < p);
+            lost[j] = bad;
+        }
+    }
+    else if (model.rfind("trace:", 0) == 0) {
+        ifstream in(model.substr(6));
+        if (!in)
+            return false;
+        string trace, line;
+        while (getline(in, line))
+            trace += line;
+        if (trace.empty())
+            return false;
+        // The trace is repeated if it is shorter than the input
+        for (unsigned j = 0; j < frameCount; j++) {
+            char c = trace[j % trace.size()];
+            lost[j] = c == '1' || c == 'x' || c == 'X';
+        }
+    }
+    else
+        return false;
+
+    // The first frame is always good, there is nothing to conceal yet
+    if (frameCount > 0)
+        lost[0] = false;
+    return true;
+}
+
+/**
+ * Segmental SNR for one frame, clamped to the usual -10..35 dB.
+ */
+static float frameSnr(const int16_t* ref, const int16_t* test) {
+    double sig = 0, err = 0;
+    for (unsigned i = 0; i < frameLen; i++) {
+        double d = (double)ref[i] - (double)test[i];
+        sig += (double)ref[i] * (double)ref[i];
+        err += d * d;
+    }
+    float snr = 10.0 * log10((sig + 1) / (err + 1));
+    return std::max(-10.0f, std::min(35.0f, snr));
+}
+
+/**
+ * Log-spectral distance (dB) for one frame. The frame is Hann
+ * windowed and zero-padded to 128 points.
+ */
+static float frameSpectralDistortion(const int16_t* ref, const int16_t* test) {
+    const unsigned n = 128;
+    double sum = 0;
+    for (unsigned k = 1; k < n / 2; k++) {
+        double re0 = 0, im0 = 0, re1 = 0, im1 = 0;
+        for (unsigned i = 0; i < frameLen; i++) {
+            double w = 0.5 - 0.5 * cos(2 * std::numbers::pi * i / frameLen);
+            double phi = -2 * std::numbers::pi * k * i / n;
+            re0 += w * ref[i] * cos(phi);
+            im0 += w * ref[i] * sin(phi);
+            re1 += w * test[i] * cos(phi);
+            im1 += w * test[i] * sin(phi);
+        }
+        // A floor keeps silent bins from dominating
+        const double floor = 1e3;
+        double p0 = re0 * re0 + im0 * im0 + floor;
+        double p1 = re1 * re1 + im1 * im1 + floor;
+        double d = 10.0 * log10(p0 / p1);
+        sum += d * d;
+    }
+    return sqrt(sum / (n / 2 - 1));
+}
+
+struct Quality {
+    double snrSum = 0;
+    double sdSum = 0;
+    unsigned frames = 0;
+};
+
+/**
+ * Scores the output on the frames that the PLC changes: the lost 
+ * frames and the first good frame after each erasure (which carries
+ * the end of the synthetic audio and the cross-fade back to the real
+ * signal). The output is delayed by lag samples. Silent reference 
+ * frames are skipped.
+ */
+static Quality score(const vector<int16_t>& ref, const vector<int16_t>& out,
+    const vector<bool>& lost, unsigned lag) {
+    Quality q;
+    for (unsigned j = 0; j < lost.size(); j++) {
+        const bool recovery = j > 0 && lost[j - 1] && !lost[j];
+        if (!lost[j] && !recovery)
+            continue;
+        unsigned start = j * frameLen;
+        if (start + lag + frameLen > out.size())
+            break;
+        double energy = 0;
+        for (unsigned i = 0; i < frameLen; i++)
+            energy += (double)ref[start + i] * (double)ref[start + i];
+        if (energy / frameLen < 100.0)
+            continue;
+        q.snrSum += frameSnr(&ref[start], &out[start + lag]);
+        q.sdSum += frameSpectralDistortion(&ref[start], &out[start + lag]);
+        q.frames++;
+    }
+    return q;
+}
+
+int main(int argc, const char** argv) {
+
+    string model = "bernoulli:0.1";
+    unsigned seed = 1;
+    unsigned repeats = 200;
+    unsigned lag = Plc::MAX_OUTPUT_LAG;
+    bool tracking = false;
+    string inName;
+
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if (a == "-m" && i + 1 < argc)
+            model = argv[++i];
+        else if (a == "-s" && i + 1 < argc)
+            seed = stoul(argv[++i]);
+        else if (a == "-r" && i + 1 < argc)
+            repeats = std::max(1ul, stoul(argv[++i]));
+        else if (a == "-l" && i + 1 < argc)
+            lag = std::min((unsigned long)Plc::MAX_OUTPUT_LAG, stoul(argv[++i]));
+        else if (a == "-p")
+            tracking = true;
+        else
+            inName = a;
+    }
+    if (inName.empty()) {
+        cout << "Argument error" << endl;
+        return -1;
+    }
+
+    vector<int16_t> ref;
+    if (!loadPcm(inName, ref)) {
+        cout << "Unable to read: " << inName << endl;
+        return -1;
+    }
+    const unsigned frameCount = ref.size() / frameLen;
+    ref.resize(frameCount * frameLen);
+
+    vector<bool> lost;
+    if (!makeLossPattern(model, seed, frameCount, lost)) {
+        cout << "Bad loss model: " << model << endl;
+        return -1;
+    }
+    unsigned lostCount = 0;
+    for (bool l : lost)
+        lostCount += l ? 1 : 0;
+
+    // Quality run
+    Plc plc;
+    plc.setOutputLag(lag);
+    plc.setPitchTracking(tracking);
+    vector<int16_t> out(ref.size());
+    vector<int16_t> silence(ref.size());
+    for (unsigned j = 0; j < frameCount; j++) {
+        if (lost[j]) {
+            plc.badFrame(&out[j * frameLen], frameLen);
+            memset(&silence[j * frameLen], 0, frameLen * sizeof(int16_t));
+        }
+        else {
+            plc.goodFrame(&ref[j * frameLen], &out[j * frameLen], frameLen);
+            memcpy(&silence[j * frameLen], &ref[j * frameLen],
+                frameLen * sizeof(int16_t));
+        }
+    }
+    Quality qPlc = score(ref, out, lost, lag);
+    Quality qSilence = score(ref, silence, lost, 0);
+
+    // Cost run. The whole input is processed repeatedly. Consecutive
+    // frames of the same type are timed together so that the clock 
+    // overhead doesn't inflate the per-second figures.
+    double goodNs = 0, badNs = 0, totalNs = 0;
+    int16_t frame[frameLen];
+    for (unsigned r = 0; r < repeats; r++) {
+        plc.reset();
+        auto runStart = chrono::steady_clock::now();
+        unsigned j = 0;
+        while (j < frameCount) {
+            const bool l = lost[j];
+            auto t0 = chrono::steady_clock::now();
+            for (; j < frameCount && lost[j] == l; j++) {
+                if (l)
+                    plc.badFrame(frame, frameLen);
+                else
+                    plc.goodFrame(&ref[j * frameLen], frame, frameLen);
+            }
+            auto t1 = chrono::steady_clock::now();
+            double ns = chrono::duration<double, nano>(t1 - t0).count();
+            if (l)
+                badNs += ns;
+            else
+                goodNs += ns;
+        }
+        totalNs += chrono::duration<double, nano>(
+            chrono::steady_clock::now() - runStart).count();
+    }
+
+    // Per-call distribution. This is a separate pass since each 
+    // sample includes the overhead of reading the clock.
+    vector<float> callNs;
+    callNs.reserve((size_t)frameCount * repeats);
+    for (unsigned r = 0; r < repeats; r++) {
+        plc.reset();
+        for (unsigned j = 0; j < frameCount; j++) {
+            auto t0 = chrono::steady_clock::now();
+            if (lost[j])
+                plc.badFrame(frame, frameLen);
+            else
+                plc.goodFrame(&ref[j * frameLen], frame, frameLen);
+            auto t1 = chrono::steady_clock::now();
+            callNs.push_back(chrono::duration<float, nano>(t1 - t0).count());
+        }
+    }
+
+    const float frameSec = (float)frameLen / sampleRate;
+    const double concealedSec = (double)lostCount * frameSec * repeats;
+    const double goodSec = (double)(frameCount - lostCount) * frameSec * repeats;
+
+    cout << "Input          : " << inName << " (" << frameCount << " frames)" << endl;
+    cout << "Loss model     : " << model << " seed " << seed << endl;
+    cout << "Output lag     : " << lag << endl;
+    cout << "Pitch tracking : " << (tracking ? "on" : "off") << endl;
+    cout << "Lost frames    : " << lostCount << " ("
+         << (100.0 * lostCount / std::max(1u, frameCount)) << "%)" << endl;
+    cout << "Scored frames  : " << qPlc.frames << endl;
+    if (qPlc.frames > 0) {
+        cout << "Seg SNR (dB)   : PLC " << qPlc.snrSum / qPlc.frames
+             << ", silence " << qSilence.snrSum / qSilence.frames << endl;
+        cout << "Spectral dist  : PLC " << qPlc.sdSum / qPlc.frames
+             << " dB, silence " << qSilence.sdSum / qSilence.frames << " dB" << endl;
+    }
+    if (concealedSec > 0)
+        cout << "Bad frame CPU  : " << (badNs / 1000.0) / concealedSec
+             << " us per concealed second" << endl;
+    if (goodSec > 0)
+        cout << "Good frame CPU : " << (goodNs / 1000.0) / goodSec
+             << " us per second" << endl;
+    if (frameCount > 0)
+        cout << "Total CPU      : " << (totalNs / 1000.0) / (concealedSec + goodSec)
+             << " us per second" << endl;
+    if (!callNs.empty()) {
+        sort(callNs.begin(), callNs.end());
+        cout << "Call time (ns) : median " << callNs[callNs.size() / 2]
+             << ", p99.9 " << callNs[(callNs.size() - 1) * 999 / 1000] 
+             << ", max " << callNs.back() << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,199 @@
+/**
+ * ITU G.711 Frame Transport
+ * Copyright (C) 2025, Bruce MacKinnon
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "itu-g711-transport/ShmRing.h"
+#include "itu-g711-plc/Plc.h"
+
+using namespace std;
+using namespace kc1fsz;
+
+/*
+Cross-process benchmark for the shared-memory frame transport.
+
+A producer process is forked and talks to this (consumer) process
+through a memfd region.
+
+1. Latency: the producer sends one 10ms uLaw frame at a time with
+   a timestamp in the payload. The consumer measures the time from
+   just before the commit until the frame is seen.
+2. Throughput: the producer fills all of the streams as fast as it
+   can, one frame per stream per "tick" with a notify() per tick,
+   and the consumer runs every frame through a Plc.
+
+Usage:
+
+./shm-bench [-s streams] [-n frames] [-w futex|poll]
+
+-s  The number of streams in the throughput test (default 256)
+-n  Frames per stream in the throughput test (default 2000)
+-w  How the consumer waits, sleeping on the futex (default) or
+    spinning.
+*/
+
+static const unsigned frameLen = Plc::FRAME_LEN;
+static const unsigned latencyCount = 20000;
+
+static uint64_t nowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void producer(int fd, unsigned streams, unsigned frames) {
+
+    ShmRing ring;
+    if (!ring.open(fd))
+        _exit(1);
+
+    // Latency phase, stream 0 only
+    for (unsigned j = 0; j < latencyCount; j++) {
+        uint8_t* p;
+        while ((p = ring.beginWrite(0)) == nullptr)
+            this_thread::yield();
+        memset(p, 0xff, frameLen);
+        uint64_t t = nowNs();
+        memcpy(p, &t, sizeof(t));
+        ring.commitWrite(0, j, frameLen, 0);
+        ring.notify();
+        // Roughly a frame every 100us
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+
+    // Throughput phase
+    for (unsigned j = 0; j < frames; j++) {
+        for (unsigned s = 0; s < streams; s++) {
+            uint8_t* p;
+            while ((p = ring.beginWrite(s)) == nullptr) {
+                ring.notify();
+                this_thread::yield();
+            }
+            memset(p, (uint8_t)j, frameLen);
+            ring.commitWrite(s, j, frameLen, 0);
+        }
+        ring.notify();
+    }
+    _exit(0);
+}
+
+int main(int argc, const char** argv) {
+
+    unsigned streams = 256;
+    unsigned frames = 2000;
+    bool poll = false;
+
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if (a == "-s" && i + 1 < argc)
+            streams = std::max(1ul, stoul(argv[++i]));
+        else if (a == "-n" && i + 1 < argc)
+            frames = std::max(1ul, stoul(argv[++i]));
+        else if (a == "-w" && i + 1 < argc)
+            poll = string(argv[++i]) == "poll";
+        else {
+            cout << "Argument error" << endl;
+            return -1;
+        }
+    }
+
+    ShmRing ring;
+    if (!ring.create(nullptr, streams, 64, frameLen)) {
+        cout << "Unable to create region" << endl;
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        cout << "Fork failed" << endl;
+        return -1;
+    }
+    if (pid == 0)
+        producer(ring.getFd(), streams, frames);
+
+    // Waits until something arrives on a stream
+    uint32_t ev = ring.getEvent();
+    auto waitFor = [&](unsigned s) {
+        while (ring.available(s) == 0)
+            if (!poll)
+                ev = ring.wait(ev, 100);
+    };
+
+    // Latency
+    vector<double> latencyUs;
+    latencyUs.reserve(latencyCount);
+    for (unsigned j = 0; j < latencyCount; j++) {
+        waitFor(0);
+        uint64_t t1 = nowNs();
+        ShmRing::View v;
+        if (!ring.peek(0, v)) {
+            cout << "Missing frame" << endl;
+            return -1;
+        }
+        uint64_t t0;
+        memcpy(&t0, v.data, sizeof(t0));
+        ring.pop(0);
+        latencyUs.push_back((t1 - t0) / 1000.0);
+    }
+    sort(latencyUs.begin(), latencyUs.end());
+
+    // Throughput
+    vector<Plc> plcs(streams);
+    vector<uint32_t> seqs(streams, 0);
+    int16_t out[frameLen];
+    unsigned goodCount = 0;
+    uint64_t t0 = nowNs();
+    for (unsigned j = 0; j < frames; j++) {
+        for (unsigned s = 0; s < streams; s++) {
+            waitFor(s);
+            if (receiveFrame(ring, s, plcs[s], out, seqs[s]))
+                goodCount++;
+        }
+    }
+    double sec = (nowNs() - t0) / 1e9;
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        cout << "Producer failed" << endl;
+        return -1;
+    }
+
+    const double total = (double)streams * frames;
+    cout << "Wait mode      : " << (poll ? "poll" : "futex") << endl;
+    cout << "Latency (us)   : median " << latencyUs[latencyUs.size() / 2]
+         << ", p99 " << latencyUs[(latencyUs.size() - 1) * 99 / 100]
+         << ", max " << latencyUs.back() << endl;
+    cout << "Streams        : " << streams << " x " << frames << " frames" << endl;
+    cout << "Throughput     : " << total / sec << " frames/s ("
+         << (total * frameLen) / sec / 1e6 << " MB/s of uLaw), "
+         << total / sec / (1000 / 10) << " streams in real time" << endl;
+    if (goodCount != total) {
+        cout << "Lost frames    : " << total - goodCount << endl;
+        return -1;
+    }
+    return 0;
+}
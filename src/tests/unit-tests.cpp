@@ -2,9 +2,27 @@
 #include <cstdint>
 #include <cassert>
 #include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "itu-g711-codec/codec.h"
+#include "itu-g711-codec/G711FileReader.h"
 #include "itu-g711-plc/Plc.h"
+#include "itu-g711-plc/StreamRegistry.h"
+#include "itu-g711-plc/Repair.h"
+#include "itu-g711-tone/ToneDetector.h"
+#include "itu-g711-pipeline/Pipeline.h"
+#include "itu-g711-transport/ShmRing.h"
 
 using namespace std;
 using namespace kc1fsz;
@@ -157,11 +175,850 @@ static void test_4() {
     }
 }
 
+/**
+ * Makes sure the pitch tracking scales with the compile-time
+ * sample rate and frame size.
+ */
+template<unsigned SampleRate, unsigned FrameMs> 
+static void test_5() {
+
+    BasicPlc<SampleRate, FrameMs> plc;
+    const unsigned frameLen = BasicPlc<SampleRate, FrameMs>::FRAME_LEN;
+
+    float f = 140;
+    float omega = 2 * 3.14156 * f / (float)SampleRate;
+    float phi = 0;
+
+    for (unsigned j = 0; j < 6; j++) {
+        int16_t inFrame[frameLen];
+        int16_t outFrame[frameLen];
+        for (unsigned i = 0; i < frameLen; i++) {
+            inFrame[i] = 0.5 * 32767.0f * std::cos(phi);
+            phi += omega;
+        }
+        if (j == 5) {
+            plc.badFrame(outFrame, frameLen);
+            // Synthesis should still be producing the tone
+            int16_t peak = 0;
+            for (unsigned i = 0; i < frameLen; i++)
+                peak = std::max(peak, outFrame[i]);
+            assert(peak > 15000);
+        }
+        else 
+            plc.goodFrame(inFrame, outFrame, frameLen);
+    }
+
+    // 140 Hz is a wavelength of 57.1 samples at 8 kHz. The search 
+    // works on the magnitude of the correlation so any multiple of 
+    // a half wavelength is a valid match.
+    float halfWaves = (float)plc.getPitchWavelength() / 
+        (0.5f * (float)SampleRate / f);
+    assert(std::fabs(halfWaves - std::round(halfWaves)) < 0.05);
+}
+
+/**
+ * Makes sure that a stream can be moved to another instance
+ * at any point without changing the output.
+ */
+static void test_6() {
+
+    Plc plc0;
+    Plc plc1;
+    Plc::Snapshot snap;
+
+    float sampleRate = 8000;
+    float f = 185;
+    float omega = 2 * 3.14156 * f / sampleRate;
+    float phi = 0;
+    const unsigned frameLen = 80;
+
+    for (unsigned j = 0; j < 60; j++) {
+
+        int16_t inFrame[frameLen];
+        int16_t outFrame0[frameLen];
+        int16_t outFrame1[frameLen];
+
+        for (unsigned i = 0; i < frameLen; i++) {
+            inFrame[i] = 0.25 * 32767.0f * (std::cos(phi) + std::cos(2.3 * phi));
+            phi += omega;
+        }
+
+        // Move the state over to a different instance on every frame
+        plc0.snapshot(snap);
+        plc1.reset();
+        assert(plc1.restore(snap));
+
+        // Erasures of various lengths
+        unsigned k = j % 20;
+        if (k == 5 || (k >= 8 && k <= 9) || (k >= 12 && k <= 18)) {
+            plc0.badFrame(outFrame0, frameLen);
+            plc1.badFrame(outFrame1, frameLen);
+        }
+        else {
+            plc0.goodFrame(inFrame, outFrame0, frameLen);
+            plc1.goodFrame(inFrame, outFrame1, frameLen);
+        }
+
+        for (unsigned i = 0; i < frameLen; i++) 
+            assert(outFrame0[i] == outFrame1[i]);
+        // Swap the roles
+        std::swap(plc0, plc1);
+    }
+
+    // Snapshots taken between erasures are fully defined
+    memset(&snap, 0xa5, sizeof(snap));
+    plc0.snapshot(snap);
+    assert(snap.erasureCount == 0);
+    for (unsigned i = 0; i < sizeof(snap.pitchBuf) / sizeof(snap.pitchBuf[0]); i++)
+        assert(snap.pitchBuf[i] == 0);
+
+    // Format mismatches are rejected
+    snap.version++;
+    assert(!plc0.restore(snap));
+}
+
+/**
+ * Block decoder and random access into recordings.
+ */
+static void test_7() {
+
+    // The block decoder must match the scalar decoder exactly
+    uint8_t allCodes[256];
+    int16_t decoded[256];
+    for (unsigned i = 0; i < 256; i++)
+        allCodes[i] = i;
+    decode_ulaw_block(allCodes, decoded, 256);
+    for (unsigned i = 0; i < 256; i++)
+        assert(decoded[i] == decode_ulaw(i));
+
+    // Make a 3 second recording with a recognizable pattern
+    const unsigned sampleCount = 24000;
+    uint8_t rec[sampleCount];
+    for (unsigned i = 0; i < sampleCount; i++)
+        rec[i] = (i * 7) & 0xff;
+
+    const char* rawName = "g711-reader-test.bin";
+    const char* wavName = "g711-reader-test.wav";
+    {
+        ofstream raw(rawName, ios::binary);
+        raw.write((const char*)rec, sampleCount);
+        // WAV with an extra chunk in front of the data
+        ofstream wav(wavName, ios::binary);
+        auto le16 = [&wav](uint16_t v) { wav.put(v & 0xff); wav.put(v >> 8); };
+        auto le32 = [&le16](uint32_t v) { le16(v & 0xffff); le16(v >> 16); };
+        wav.write("RIFF", 4); le32(4 + 26 + 10 + 8 + sampleCount);
+        wav.write("WAVE", 4);
+        wav.write("fmt ", 4); le32(18); 
+        le16(7); le16(1); le32(8000); le32(8000); le16(1); le16(8); le16(0);
+        wav.write("LIST", 4); le32(1); wav.write("xx", 2);
+        wav.write("data", 4); le32(sampleCount);
+        wav.write((const char*)rec, sampleCount);
+    }
+
+    for (const char* name : { rawName, wavName }) {
+        G711FileReader reader;
+        assert(reader.open(name));
+        assert(reader.getSampleRate() == 8000);
+        assert(reader.getSampleCount() == sampleCount);
+
+        // A view into the middle
+        span<const uint8_t> v = reader.encoded(1250, 500);
+        assert(v.size() == 4000);
+        assert(v[0] == rec[10000]);
+        assert(v[3999] == rec[13999]);
+
+        // Clipped at the end
+        int16_t pcm[8000];
+        unsigned n = reader.decode(2500, 1000, pcm, 8000);
+        assert(n == 4000);
+        for (unsigned i = 0; i < n; i++)
+            assert(pcm[i] == decode_ulaw(rec[20000 + i]));
+        // Clipped to the output buffer
+        assert(reader.decode(0, 3000, pcm, 100) == 100);
+        // Completely past the end
+        assert(reader.encoded(5000, 10).size() == 0);
+    }
+
+    remove(rawName);
+    remove(wavName);
+
+    G711FileReader reader;
+    assert(!reader.open("g711-reader-test.missing"));
+}
+
+/**
+ * The pipeline stages should give the same results as calling 
+ * the CODEC and PLC directly.
+ */
+static void test_8() {
+
+    const unsigned frameLen = 80;
+    typedef Frame<frameLen * 2> FrameT;
+    const unsigned poolSize = 4;
+    FramePool<FrameT, poolSize> pool;
+
+    Plc plc0, plc1;
+    uint8_t pipeOut[frameLen];
+    auto sinkFn = [&pipeOut](const FrameT& f) {
+        assert(f.len == frameLen);
+        for (unsigned i = 0; i < f.len; i++)
+            pipeOut[i] = f.ulaw[i];
+    };
+    SinkStage<FrameT, poolSize, decltype(sinkFn)> sink(pool, sinkFn);
+    EncodeStage<FrameT, decltype(sink)> encode(sink);
+    PlcStage<FrameT, Plc, decltype(encode)> plcStage(plc0, encode);
+    DecodeStage<FrameT, decltype(plcStage)> decode(plcStage);
+
+    float omega = 2 * 3.14156 * 310 / 8000;
+    float phi = 0;
+
+    for (unsigned j = 0; j < 40; j++) {
+
+        uint8_t inFrame[frameLen];
+        for (unsigned i = 0; i < frameLen; i++) {
+            inFrame[i] = encode_ulaw(0.5 * 32767.0f * std::cos(phi));
+            phi += omega;
+        }
+        bool erased = (j % 7) == 3 || (j % 11) == 5;
+
+        // The direct way
+        int16_t pcm[frameLen];
+        if (erased) 
+            plc1.badFrame(pcm, frameLen);
+        else {
+            for (unsigned i = 0; i < frameLen; i++)
+                pcm[i] = decode_ulaw(inFrame[i]);
+            plc1.goodFrame(pcm, pcm, frameLen);
+        }
+
+        // The pipeline way
+        FrameT* f = pool.acquire();
+        assert(f != nullptr);
+        f->erased = erased;
+        f->len = frameLen;
+        for (unsigned i = 0; i < frameLen; i++)
+            f->ulaw[i] = inFrame[i];
+        decode.push(f);
+
+        for (unsigned i = 0; i < frameLen; i++)
+            assert(pipeOut[i] == encode_ulaw(pcm[i]));
+    }
+
+    // Everything should have been returned
+    assert(pool.available() == poolSize);
+
+    // Resampling and mixing
+    unsigned lastLen = 0;
+    int16_t lastPcm[frameLen * 2];
+    auto sinkFn2 = [&](const FrameT& f) {
+        lastLen = f.len;
+        for (unsigned i = 0; i < f.len; i++)
+            lastPcm[i] = f.pcm[i];
+    };
+    SinkStage<FrameT, poolSize, decltype(sinkFn2)> sink2(pool, sinkFn2);
+    ResampleStage<FrameT, 8000, 16000, decltype(sink2)> up(sink2);
+    MixStage<FrameT, poolSize, decltype(up)> mix(pool, up);
+
+    for (unsigned j = 0; j < 2; j++) {
+        for (int16_t level : { 10000, 15000, 20000 }) {
+            FrameT* f = pool.acquire();
+            f->len = frameLen;
+            for (unsigned i = 0; i < frameLen; i++)
+                f->pcm[i] = level;
+            mix.push(f);
+        }
+        mix.flush();
+        assert(lastLen == frameLen * 2);
+    }
+    // Saturated, and the interpolation has settled by the second tick
+    for (unsigned i = 0; i < lastLen; i++)
+        assert(lastPcm[i] == 32767);
+    assert(pool.available() == poolSize);
+}
+
+/**
+ * Stream registry: slots are not reused within a tick and concurrent
+ * acquire/release never hands out the same slot twice.
+ */
+static void test_9() {
+
+    typedef StreamRegistry<64> Registry;
+    static_assert(sizeof(Registry::Slot) % 64 == 0);
+    static Registry reg;
+
+    int a = reg.acquire(100);
+    int b = reg.acquire(101);
+    assert(a >= 0 && b >= 0 && a != b);
+    reg.beginTick();
+    assert(reg.activeCount() == 2);
+    // Released mid-tick: still visited until the next tick and 
+    // not available for reuse.
+    reg.release(a);
+    unsigned visited = 0;
+    reg.forEachActive([&visited](unsigned, Registry::Slot&) { visited++; });
+    assert(visited == 2);
+    for (unsigned i = 0; i < 62; i++)
+        assert(reg.acquire(i) != a);
+    assert(reg.acquire(999) == -1);
+    reg.beginTick();
+    assert(reg.activeCount() == 63);
+    // Now the slot can be reused
+    assert(reg.acquire(200) == a);
+    assert(reg.get(a).tag == 200);
+
+    // Clean up
+    reg.beginTick();
+    reg.forEachActive([](unsigned i, Registry::Slot&) { reg.release(i); });
+    reg.beginTick();
+    assert(reg.activeCount() == 0);
+
+    // Stress: signaling threads churning streams while the media 
+    // thread ticks and makes sure it has exclusive use of each slot.
+    static std::atomic<uint32_t> owner[64];
+    std::atomic<bool> done { false };
+    std::thread media([&done]() {
+        int16_t out[80];
+        while (!done.load()) {
+            reg.beginTick();
+            reg.forEachActive([&out](unsigned i, Registry::Slot& slot) {
+                // The tag identifies the thread that acquired the slot.
+                // The owner may have released it in the meantime, but 
+                // nobody else can have it yet.
+                uint64_t tag = slot.tag;
+                slot.plc.badFrame(out, 80);
+                uint32_t o = owner[i].load();
+                assert(slot.tag == tag && (o == 0 || o == tag));
+            });
+        }
+    });
+    std::vector<std::thread> signaling;
+    for (unsigned t = 1; t <= 4; t++) {
+        signaling.emplace_back([t]() {
+            int mine[8];
+            for (unsigned n = 0; n < 2000; n++) {
+                for (unsigned k = 0; k < 8; k++) {
+                    mine[k] = reg.acquire(t);
+                    if (mine[k] >= 0) {
+                        uint32_t expected = 0;
+                        assert(owner[mine[k]].compare_exchange_strong(expected, t));
+                    }
+                }
+                for (unsigned k = 0; k < 8; k++) {
+                    if (mine[k] >= 0) {
+                        owner[mine[k]].store(0);
+                        reg.release(mine[k]);
+                    }
+                }
+            }
+        });
+    }
+    for (auto& t : signaling)
+        t.join();
+    done.store(true);
+    media.join();
+}
+
+/**
+ * Low-latency modes.
+ */
+static void test_10() {
+
+    const unsigned frameLen = 80;
+    float omega = 2 * 3.14156 * 140 / 8000;
+
+    for (unsigned lag : { 0, 5, 12, 30 }) {
+
+        Plc plc;
+        plc.setOutputLag(lag);
+        assert(plc.getOutputLag() == lag);
+
+        float phi = 0;
+        int16_t lastOut = 0;
+        int maxStep = 0;
+
+        for (unsigned j = 0; j < 30; j++) {
+            int16_t inFrame[frameLen];
+            int16_t outFrame[frameLen];
+            for (unsigned i = 0; i < frameLen; i++) {
+                inFrame[i] = 16000.0f * std::cos(phi);
+                phi += omega;
+            }
+            bool erased = (j % 10) >= 6 && (j % 10) <= (j / 10) + 6;
+            if (erased)
+                plc.badFrame(outFrame, frameLen);
+            else {
+                plc.goodFrame(inFrame, outFrame, frameLen);
+                // No lag means no change to good frames
+                if (lag == 0 && j % 10 < 6 && j % 10 != 0)
+                    for (unsigned i = 0; i < frameLen; i++)
+                        assert(outFrame[i] == inFrame[i]);
+            }
+            // Look for discontinuities going into the erasures
+            for (unsigned i = 0; i < frameLen; i++) {
+                if (j % 10 == 6)
+                    maxStep = std::max(maxStep, std::abs(outFrame[i] - lastOut));
+                lastOut = outFrame[i];
+            }
+        }
+        // The largest step in the tone itself is about 1760
+        assert(maxStep < 3000);
+    }
+}
+
+/**
+ * The parallel repair must match a single sequential pass.
+ */
+static void test_11() {
+
+    const unsigned frameLen = 80;
+    const unsigned frameCount = 3000;
+    static int16_t pcm[frameLen * frameCount];
+    static int16_t out0[frameLen * frameCount];
+    static int16_t out1[frameLen * frameCount];
+    static uint8_t lossMap[frameCount / 8 + 1];
+
+    float phi = 0;
+    for (unsigned i = 0; i < frameLen * frameCount; i++) {
+        // Sweep the pitch around so that each erasure is different
+        float f = 120 + 80 * std::sin(i * 0.0003);
+        pcm[i] = 9000 * std::cos(phi) + 4000 * std::cos(2.1 * phi);
+        phi += 2 * 3.14156 * f / 8000;
+    }
+
+    uint32_t rnd = 7;
+    for (unsigned j = 0; j < frameCount; ) {
+        rnd = rnd * 1664525 + 1013904223;
+        // Bursts of 1-4 lost frames with good runs of various lengths
+        unsigned good = (rnd >> 8) % 15;
+        unsigned bad = 1 + (rnd >> 20) % 4;
+        j += good;
+        for (unsigned k = 0; k < bad && j < frameCount; k++, j++)
+            lossMap[j / 8] |= 1 << (j % 8);
+    }
+
+    for (unsigned lag : { 30, 0 }) {
+        Plc plc;
+        plc.setOutputLag(lag);
+        for (unsigned j = 0; j < frameCount; j++) {
+            if ((lossMap[j / 8] >> (j % 8)) & 1)
+                plc.badFrame(out0 + j * frameLen, frameLen);
+            else
+                plc.goodFrame(pcm + j * frameLen, out0 + j * frameLen, frameLen);
+        }
+        for (unsigned threads : { 1, 4 }) {
+            memset(out1, 0, sizeof(out1));
+            repairRecording(pcm, lossMap, frameCount, out1, threads, lag);
+            assert(memcmp(out0, out1, sizeof(out0)) == 0);
+        }
+    }
+}
+
+/**
+ * DTMF and call progress tone detection on a batch of streams.
+ */
+static void test_12() {
+
+    ToneDetector det;
+    int dial350 = det.addTone(350);
+    int dial440 = det.addTone(440);
+    int busy480 = det.addTone(480);
+    assert(dial350 == 0 && dial440 == 1 && busy480 == 2);
+
+    // Stream 0: silence, 1: digit 5, 2: dial tone, 3: digit #, 
+    // 4: a single DTMF tone (not a digit)
+    const unsigned streamCount = 5;
+    const float freqs[streamCount][2] = { 
+        { 0, 0 }, { 770, 1336 }, { 350, 440 }, { 941, 1477 }, { 1209, 0 } };
+    ToneDetector::State states[streamCount];
+    for (unsigned s = 0; s < streamCount; s++)
+        det.resetState(states[s]);
+
+    const unsigned frameLen = 80;
+    unsigned blocks[streamCount] = { 0 };
+    for (unsigned j = 0; j < 20; j++) {
+        uint8_t frames[streamCount][frameLen];
+        const uint8_t* framePtrs[streamCount];
+        for (unsigned s = 0; s < streamCount; s++) {
+            for (unsigned i = 0; i < frameLen; i++) {
+                float t = (float)(j * frameLen + i) / 8000.0;
+                float a = 0;
+                for (float f : freqs[s])
+                    if (f > 0)
+                        a += 6000 * std::cos(2 * 3.14159 * f * t);
+                frames[s][i] = encode_ulaw(a);
+            }
+            framePtrs[s] = frames[s];
+        }
+        bool completed[streamCount];
+        det.processBatch(states, framePtrs, streamCount, frameLen, completed);
+        for (unsigned s = 0; s < streamCount; s++)
+            if (completed[s])
+                blocks[s]++;
+    }
+
+    // 1600 samples is 7 complete blocks
+    for (unsigned s = 0; s < streamCount; s++)
+        assert(blocks[s] == 7);
+    assert(states[0].digit == 0 && states[0].tones == 0);
+    assert(states[1].digit == '5' && states[1].tones == 0);
+    assert(states[2].digit == 0 && states[2].tones == 0b011);
+    assert(states[3].digit == '#' && states[3].tones == 0);
+    assert(states[4].digit == 0 && states[4].tones == 0);
+}
+
+/**
+ * Long outages in one call must match frame-by-frame concealment.
+ */
+static void test_13() {
+
+    const unsigned frameLen = 80;
+    float omega = 2 * 3.14156 * 180 / 8000;
+
+    for (unsigned lag : { 0, 12, 30 }) {
+        for (unsigned outage : { 1, 2, 3, 4, 60, 500 }) {
+
+            Plc plc0, plc1;
+            plc0.setOutputLag(lag);
+            plc1.setOutputLag(lag);
+            float phi = 0;
+            std::vector<int16_t> out0(frameLen * outage), out1(frameLen * outage);
+
+            for (unsigned j = 0; j < 40; j++) {
+                int16_t inFrame[frameLen];
+                int16_t outFrame0[frameLen];
+                int16_t outFrame1[frameLen];
+                for (unsigned i = 0; i < frameLen; i++) {
+                    inFrame[i] = 12000.0f * std::cos(phi) + 3000.0f * std::cos(3.1 * phi);
+                    phi += omega;
+                }
+                if (j == 20) {
+                    for (unsigned k = 0; k < outage; k++)
+                        plc0.badFrame(&out0[k * frameLen], frameLen);
+                    plc1.badFrames(&out1[0], outage, frameLen);
+                    assert(out0 == out1);
+                }
+                // The recovery must also be the same
+                plc0.goodFrame(inFrame, outFrame0, frameLen);
+                plc1.goodFrame(inFrame, outFrame1, frameLen);
+                assert(memcmp(outFrame0, outFrame1, sizeof(outFrame0)) == 0);
+            }
+            // And a second erasure (which uses the history)
+            int16_t outFrame0[frameLen];
+            int16_t outFrame1[frameLen];
+            plc0.badFrame(outFrame0, frameLen);
+            plc1.badFrame(outFrame1, frameLen);
+            assert(memcmp(outFrame0, outFrame1, sizeof(outFrame0)) == 0);
+        }
+    }
+}
+
+/**
+ * A 20ms instance follows the same Appendix I timing as a 10ms
+ * instance that is called twice per frame.
+ */
+static void test_16() {
+
+    BasicPlc<8000, 20> plc20;
+    Plc plc10;
+    const unsigned frameLen = BasicPlc<8000, 20>::FRAME_LEN;
+
+    float omega = 2 * 3.14156 * 150 / 8000.0;
+    float phi = 0;
+
+    for (unsigned j = 0; j < 10; j++) {
+        int16_t inFrame[frameLen], out20[frameLen], out10[frameLen];
+        for (unsigned i = 0; i < frameLen; i++) {
+            inFrame[i] = 0.25 * 32767.0f * std::cos(phi);
+            phi += omega;
+        }
+        // Three lost frames (60ms)
+        if (j >= 7) {
+            plc20.badFrame(out20, frameLen);
+            plc10.badFrame(out10, Plc::FRAME_LEN);
+            plc10.badFrame(out10 + Plc::FRAME_LEN, Plc::FRAME_LEN);
+        }
+        else {
+            plc20.goodFrame(inFrame, out20, frameLen);
+            plc10.goodFrame(inFrame, out10, Plc::FRAME_LEN);
+            plc10.goodFrame(inFrame + Plc::FRAME_LEN, out10 + Plc::FRAME_LEN, 
+                Plc::FRAME_LEN);
+        }
+        assert(memcmp(out20, out10, sizeof(out20)) == 0);
+        // The attenuation starts after 10ms at 20% per 10ms, so it 
+        // is below 20% for the last 10ms
+        if (j == 9) {
+            int16_t peak = 0;
+            for (unsigned i = Plc::FRAME_LEN; i < frameLen; i++)
+                peak = std::max(peak, (int16_t)std::abs(out20[i]));
+            assert(peak < 0.2 * 0.25 * 32767.0f);
+        }
+    }
+}
+
+/**
+ * Incremental pitch tracking. 
+ */
+template<unsigned SampleRate, unsigned FrameMs> static void test_14() {
+
+    const unsigned frameLen = BasicPlc<SampleRate, FrameMs>::FRAME_LEN;
+    BasicPlc<SampleRate, FrameMs> plc0, plc1, plc2;
+    plc1.setPitchTracking(true);
+    plc2.setPitchTracking(true);
+    assert(!plc0.getPitchTracking() && plc1.getPitchTracking());
+
+    float phi = 0;
+    for (unsigned j = 0; j < 200; j++) {
+        int16_t inFrame[frameLen];
+        int16_t outFrame0[frameLen];
+        int16_t outFrame1[frameLen];
+        int16_t outFrame2[frameLen];
+        for (unsigned i = 0; i < frameLen; i++) {
+            // Sweep the pitch so that each erasure is different
+            float f = 110 + 70 * std::sin((j * frameLen + i) * 0.002f * 8000 / SampleRate);
+            inFrame[i] = 9000.0f * std::cos(phi) + 3000.0f * std::cos(2.2 * phi);
+            phi += 2 * 3.14156 * f / SampleRate;
+        }
+        // Move the tracking state to another instance just before an
+        // erasure starts
+        if (j == 78) {
+            typename BasicPlc<SampleRate, FrameMs>::Snapshot snap;
+            plc1.snapshot(snap);
+            plc2.restore(snap);
+        }
+        if ((j % 9) >= 6) {
+            plc0.badFrame(outFrame0, frameLen);
+            plc1.badFrame(outFrame1, frameLen);
+            plc2.badFrame(outFrame2, frameLen);
+            assert(plc0.getPitchWavelength() == plc1.getPitchWavelength());
+        }
+        else {
+            plc0.goodFrame(inFrame, outFrame0, frameLen);
+            plc1.goodFrame(inFrame, outFrame1, frameLen);
+            // Before the restore this one gets unrelated audio
+            if (j < 78)
+                for (unsigned i = 0; i < frameLen; i++)
+                    inFrame[i] = (i % 41) * 500;
+            plc2.goodFrame(inFrame, outFrame2, frameLen);
+        }
+        // For a clean signal the estimates agree so the outputs match
+        assert(memcmp(outFrame0, outFrame1, sizeof(outFrame0)) == 0);
+        if (j >= 78)
+            assert(memcmp(outFrame1, outFrame2, sizeof(outFrame1)) == 0);
+    }
+}
+
+/**
+ * Passes good frames straight through, slowly.
+ */
+struct SlowReaderPlc {
+    static constexpr unsigned FRAME_LEN = 80;
+    void goodFrame(const int16_t* in, int16_t* out, unsigned len) {
+        for (unsigned i = 0; i < len; i++) {
+            if (i == len / 2)
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            out[i] = in[i];
+        }
+    }
+    void badFrame(int16_t* out, unsigned len) {
+        memset(out, 0, len * sizeof(int16_t));
+    }
+};
+
+/**
+ * Shared-memory transport between two processes.
+ */
+static void test_15() {
+
+    const unsigned frameLen = 80;
+    const unsigned frameCount = 300;
+
+    // Frames 3, 13, ... are marked as lost, frames 7, 17, ... are 
+    // never sent and frame 50 is sent twice.
+    auto makeFrame = [](unsigned j, int16_t* pcm) {
+        for (unsigned i = 0; i < frameLen; i++)
+            pcm[i] = 8000 * std::cos((j * frameLen + i) * 0.11) + j;
+    };
+
+    ShmRing ring;
+    assert(ring.create(nullptr, 2, 512, frameLen));
+    assert(ring.getStreamCount() == 2);
+    uint32_t ev0 = ring.getEvent();
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        // The producer maps the region on its own
+        ShmRing tx;
+        if (!tx.open(ring.getFd()))
+            _exit(1);
+        for (unsigned j = 0; j < frameCount; j++) {
+            int16_t pcm[frameLen];
+            makeFrame(j, pcm);
+            if (j % 10 != 7) {
+                uint8_t* p = tx.beginWrite(0);
+                for (unsigned i = 0; i < frameLen; i++)
+                    p[i] = encode_ulaw(pcm[i]);
+                tx.commitWrite(0, j, frameLen, 
+                    (j % 10 == 3) ? ShmRing::FLAG_LOST : 0);
+                if (j == 50)
+                    tx.write(0, j, p, frameLen, 0);
+            }
+            tx.write(1, j, pcm, frameLen, ShmRing::FLAG_PCM);
+        }
+        tx.notify();
+        _exit(0);
+    }
+
+    // Block until the producer rings
+    uint32_t ev = ev0;
+    while (ev == ev0)
+        ev = ring.wait(ev, 1000);
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(ring.available(0) == frameCount - 30 + 1);
+    assert(ring.available(1) == frameCount);
+
+    Plc plc0, plc1, ref0, ref1;
+    uint32_t seq0 = 0, seq1 = 0;
+    for (unsigned j = 0; j < frameCount; j++) {
+        int16_t pcm[frameLen], out[frameLen], refOut[frameLen];
+        makeFrame(j, pcm);
+
+        bool good = receiveFrame(ring, 0, plc0, out, seq0);
+        assert(good == (j % 10 != 3 && j % 10 != 7));
+        if (good) {
+            uint8_t ulaw[frameLen];
+            for (unsigned i = 0; i < frameLen; i++)
+                ulaw[i] = encode_ulaw(pcm[i]);
+            int16_t decoded[frameLen];
+            decode_ulaw_block(ulaw, decoded, frameLen);
+            ref0.goodFrame(decoded, refOut, frameLen);
+        }
+        else
+            ref0.badFrame(refOut, frameLen);
+        assert(memcmp(out, refOut, sizeof(out)) == 0);
+
+        assert(receiveFrame(ring, 1, plc1, out, seq1));
+        ref1.goodFrame(pcm, refOut, frameLen);
+        assert(memcmp(out, refOut, sizeof(out)) == 0);
+    }
+    assert(ring.available(0) == 0 && ring.available(1) == 0);
+
+    // Named regions, and a full stream
+    char name[64];
+    snprintf(name, sizeof(name), "/g711-unit-test-%d", (int)getpid());
+    ShmRing a, b;
+    assert(a.create(name, 1, 4, 160));
+    assert(b.open(name));
+    ShmRing::unlink(name);
+    assert(b.getSlotCount() == 4 && b.getMaxSamples() == 160);
+    uint8_t data[160] = { 1, 2, 3 };
+    for (unsigned j = 0; j < 4; j++)
+        assert(a.write(0, j, data, 160, 0));
+    assert(!a.write(0, 4, data, 160, 0));
+    ShmRing::View v;
+    assert(b.peek(0, v) && v.seq == 0 && v.len == 160 && v.data[2] == 3);
+    b.pop(0);
+    assert(a.write(0, 4, data, 160, 0));
+
+    // Frames that don't fit in a slot are rejected
+    b.pop(0);
+    int16_t big[161] = { 0 };
+    assert(!a.write(0, 5, big, 161, ShmRing::FLAG_PCM));
+    assert(a.beginWrite(0) != nullptr);
+    assert(!a.commitWrite(0, 5, 161, 0));
+    assert(a.available(0) == 3);
+
+    // A producer that restarts (or jumps ahead) is picked up right
+    // away instead of being treated as stale/early.
+    {
+        ShmRing c;
+        assert(c.create(nullptr, 1, 8, frameLen));
+        Plc plc, ref;
+        uint32_t seq = 0;
+        const uint32_t seqs[] = { 0, 20, 0, 20, 1000000, 0 };
+        for (unsigned r = 0; r < 6; r++) {
+            for (unsigned j = 0; j < 20; j++) {
+                int16_t pcm[frameLen], out[frameLen], refOut[frameLen];
+                for (unsigned i = 0; i < frameLen; i++)
+                    pcm[i] = (int16_t)(r * 1000 + j * 7 + i);
+                uint32_t s = seqs[r] + j;
+                assert(c.write(0, s, pcm, frameLen, ShmRing::FLAG_PCM));
+                assert(receiveFrame(c, 0, plc, out, seq));
+                assert(seq == s + 1);
+                ref.goodFrame(pcm, refOut, frameLen);
+                assert(memcmp(out, refOut, sizeof(out)) == 0);
+            }
+        }
+    }
+
+    // The consumer runs at the same time as the producer through a 
+    // small ring. The PLC stand-in pauses half way through reading 
+    // each payload, so a slot that is released before it has been 
+    // read gets overwritten by a later frame.
+    {
+        const unsigned count = 2000;
+        ShmRing c;
+        assert(c.create(nullptr, 1, 4, frameLen));
+        const pid_t parent = getpid();
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (pid == 0) {
+            ShmRing tx;
+            if (!tx.open(c.getFd()))
+                _exit(1);
+            for (unsigned j = 0; j < count; j++) {
+                int16_t* p;
+                // Give up if the consumer fails
+                while ((p = (int16_t*)tx.beginWrite(0)) == nullptr)
+                    if (getppid() != parent)
+                        _exit(1);
+                for (unsigned i = 0; i < frameLen; i++)
+                    p[i] = (int16_t)(j * 7 + i);
+                tx.commitWrite(0, j, frameLen, ShmRing::FLAG_PCM);
+            }
+            _exit(0);
+        }
+        SlowReaderPlc plc;
+        uint32_t seq = 0;
+        for (unsigned j = 0; j < count; j++) {
+            while (c.available(0) == 0)
+                ;
+            int16_t out[frameLen];
+            assert(receiveFrame(c, 0, plc, out, seq));
+            for (unsigned i = 0; i < frameLen; i++)
+                assert(out[i] == (int16_t)(j * 7 + i));
+        }
+        waitpid(pid, &status, 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+}
+
 int main(int,const char**) {
     //test_1();
     //test_2();
     //test_3();
     test_4();
+    test_5<8000, 10>();
+    test_5<8000, 20>();
+    test_5<16000, 10>();
+    test_5<48000, 10>();
+    test_6();
+    test_7();
+    test_8();
+    test_9();
+    test_10();
+    test_11();
+    test_12();
+    test_13();
+    test_14<8000, 10>();
+    test_14<8000, 20>();
+    test_14<16000, 10>();
+    test_15();
+    test_16();
+    // Make sure the 8 kHz buffers are sized tightly
+    static_assert(sizeof(Plc) < 2048);
     return 0;
 }
 